@@ -324,9 +324,10 @@ int microbit_hal_display_get_pixel(int x, int y) {
     }
 }
 
+// This mapping is designed to give a set of 10 visually distinct levels.
+static const uint8_t bright_map[10] = { 0, 1, 2, 4, 8, 16, 32, 64, 128, 255 };
+
 void microbit_hal_display_set_pixel(int x, int y, int bright) {
-    // This mapping is designed to give a set of 10 visually distinct levels.
-    static uint8_t bright_map[10] = { 0, 1, 2, 4, 8, 16, 32, 64, 128, 255 };
     if (bright < 0) {
         bright = 0;
     } else if (bright > 9) {
@@ -335,6 +336,15 @@ void microbit_hal_display_set_pixel(int x, int y, int bright) {
     uBit.display.image.setPixelValue(x, y, bright_map[bright]);
 }
 
+void microbit_hal_display_set_frame(const uint8_t *levels) {
+    // The display image is 5x5 and stored row by row, so write it directly.
+    uint8_t *bitmap = uBit.display.image.getBitmap();
+    for (int i = 0; i < 25; ++i) {
+        uint8_t bright = levels[i];
+        bitmap[i] = bright_map[bright > 9 ? 9 : bright];
+    }
+}
+
 int microbit_hal_display_read_light_level(void) {
     return uBit.display.readLightLevel();
 }
@@ -73,6 +73,9 @@ extern "C" {
 #define MICROBIT_HAL_PIN_TOUCH_RESISTIVE (0)
 #define MICROBIT_HAL_PIN_TOUCH_CAPACITIVE (1)
 
+// Maximum number of strips for microbit_hal_pin_write_ws2812_multi().
+#define MICROBIT_HAL_WS2812_MULTI_MAX (8)
+
 #define MICROBIT_HAL_ACCELEROMETER_EVT_NONE         (0)
 #define MICROBIT_HAL_ACCELEROMETER_EVT_TILT_UP      (1)
 #define MICROBIT_HAL_ACCELEROMETER_EVT_TILT_DOWN    (2)
@@ -125,6 +128,9 @@ int microbit_hal_pin_read_analog_u10(int pin);
 void microbit_hal_pin_write_analog_u10(int pin, int value);
 int microbit_hal_pin_is_touched(int pin);
 void microbit_hal_pin_write_ws2812(int pin, const uint8_t *buf, size_t len);
+int microbit_hal_pin_write_ws2812_async(int pin, const uint8_t *buf, size_t len);
+bool microbit_hal_pin_ws2812_busy(void);
+void microbit_hal_pin_write_ws2812_multi(size_t n, const int *pins, const uint8_t *const *bufs, const size_t *lens);
 
 int microbit_hal_i2c_init(int scl, int sda, int freq);
 int microbit_hal_i2c_readfrom(uint8_t addr, uint8_t *buf, size_t len, int stop);
@@ -141,6 +147,7 @@ void microbit_hal_display_enable(int value);
 void microbit_hal_display_clear(void);
 int microbit_hal_display_get_pixel(int x, int y);
 void microbit_hal_display_set_pixel(int x, int y, int bright);
+void microbit_hal_display_set_frame(const uint8_t levels[25]);
 int microbit_hal_display_read_light_level(void);
 
 void microbit_hal_accelerometer_get_sample(int axis[3]);
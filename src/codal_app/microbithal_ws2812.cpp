@@ -0,0 +1,256 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Damien P. George
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "main.h"
+#include "microbithal.h"
+
+// Non-blocking WS2812 output using a PWM peripheral with EasyDMA.
+//
+// Each bit on the wire is one PWM period whose duty cycle encodes 0 or 1.
+// Expanding a whole strip this way takes 16 bytes of RAM per data byte, so
+// instead two small sequence buffers are played back-to-back in loop mode and
+// each one is refilled from the PWM interrupt while the other is playing.
+
+// PWM3 is reserved for this driver: CODAL drives audio and analog pin output
+// from the lower-numbered PWM instances.  Defining the IRQ handler here makes
+// the link fail if CODAL ever takes PWM3 over, and the peripheral is checked to
+// be disabled before each transfer in case something enables it at run time.
+#define WS2812_PWM NRF_PWM3
+#define WS2812_PWM_IRQn PWM3_IRQn
+#define WS2812_PWM_IRQHandler PWM3_IRQHandler
+
+// A refill only has to happen within the 240us it takes the other buffer to
+// play, so run below the radio (priority 3) and the CODAL system timers.
+#define WS2812_PWM_IRQ_PRIORITY (5)
+
+// With a 16MHz PWM clock, 20 ticks gives the 1.25us bit period.  Setting bit 15
+// makes the output high for the first part of the period.
+#define WS2812_PWM_TOP (20)
+#define WS2812_PWM_T0H (0x8000 | 6)
+#define WS2812_PWM_T1H (0x8000 | 13)
+#define WS2812_PWM_LOW (0x8000)
+
+// Number of data bytes per sequence buffer.  One buffer takes 240us to play.
+#define WS2812_CHUNK_BYTES (24)
+
+// All-low chunks sent after the data as the latch/reset period.  Current
+// WS2812B parts need at least 280us, so one chunk is not enough.
+#define WS2812_RESET_CHUNKS (2)
+
+static uint16_t ws2812_seq[2][WS2812_CHUNK_BYTES * 8];
+static const uint8_t *ws2812_src;
+static size_t ws2812_src_len;
+static volatile bool ws2812_busy = false;
+
+static void ws2812_fill_seq(uint16_t *seq) {
+    size_t n = ws2812_src_len < WS2812_CHUNK_BYTES ? ws2812_src_len : WS2812_CHUNK_BYTES;
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t b = ws2812_src[i];
+        for (size_t j = 0; j < 8; ++j) {
+            *seq++ = (b & 0x80) ? WS2812_PWM_T1H : WS2812_PWM_T0H;
+            b <<= 1;
+        }
+    }
+    for (size_t i = n * 8; i < WS2812_CHUNK_BYTES * 8; ++i) {
+        *seq++ = WS2812_PWM_LOW;
+    }
+    ws2812_src += n;
+    ws2812_src_len -= n;
+}
+
+extern "C" void WS2812_PWM_IRQHandler(void) {
+    if (WS2812_PWM->EVENTS_SEQEND[0]) {
+        WS2812_PWM->EVENTS_SEQEND[0] = 0;
+        ws2812_fill_seq(ws2812_seq[0]);
+    }
+    if (WS2812_PWM->EVENTS_SEQEND[1]) {
+        WS2812_PWM->EVENTS_SEQEND[1] = 0;
+        ws2812_fill_seq(ws2812_seq[1]);
+    }
+    if (WS2812_PWM->EVENTS_STOPPED) {
+        WS2812_PWM->EVENTS_STOPPED = 0;
+        WS2812_PWM->INTENCLR = 0xffffffff;
+        WS2812_PWM->ENABLE = PWM_ENABLE_ENABLE_Disabled;
+        WS2812_PWM->PSEL.OUT[0] = 0xffffffff;
+        ws2812_busy = false;
+    }
+}
+
+// Blocking output to several strips at once, by bit-banging all their pins in
+// parallel.  Timing uses the DWT cycle counter (64MHz core clock).
+#define WS2812_CYCLES_T0H (24) // 0.375us
+#define WS2812_CYCLES_T1H (48) // 0.75us
+#define WS2812_CYCLES_BIT (80) // 1.25us
+
+// Per-port masks of the pins that are sending a byte, and of those sending a 1
+// for each of its bits.
+typedef struct _ws2812_byte_masks_t {
+    uint32_t all[2];
+    uint32_t ones[8][2];
+} ws2812_byte_masks_t;
+
+typedef struct _ws2812_multi_t {
+    size_t n;
+    const uint8_t *const *bufs;
+    const size_t *lens;
+    uint32_t ports[MICROBIT_HAL_WS2812_MULTI_MAX];
+    uint32_t masks[MICROBIT_HAL_WS2812_MULTI_MAX];
+} ws2812_multi_t;
+
+// Fill in bit j of byte k for every strip.  Bit 0 also works out which strips
+// still have data at byte k.
+static inline void ws2812_expand_bit(const ws2812_multi_t *multi, ws2812_byte_masks_t *out, size_t k, size_t j) {
+    if (j == 0) {
+        out->all[0] = 0;
+        out->all[1] = 0;
+        for (size_t i = 0; i < multi->n; ++i) {
+            if (k < multi->lens[i]) {
+                out->all[multi->ports[i]] |= multi->masks[i];
+            }
+        }
+    }
+    out->ones[j][0] = 0;
+    out->ones[j][1] = 0;
+    for (size_t i = 0; i < multi->n; ++i) {
+        if (k < multi->lens[i] && (multi->bufs[i][k] & (0x80 >> j))) {
+            out->ones[j][multi->ports[i]] |= multi->masks[i];
+        }
+    }
+}
+
+// Send byte k, working out the masks for byte k + 1 in the low part of each bit
+// so that no gap builds up between bytes.
+static void ws2812_write_byte(const ws2812_multi_t *multi, const ws2812_byte_masks_t *cur, ws2812_byte_masks_t *next, size_t k) {
+    for (size_t j = 0; j < 8; ++j) {
+        uint32_t t0 = DWT->CYCCNT;
+        NRF_P0->OUTSET = cur->all[0];
+        NRF_P1->OUTSET = cur->all[1];
+        while (DWT->CYCCNT - t0 < WS2812_CYCLES_T0H) {
+        }
+        NRF_P0->OUTCLR = cur->all[0] & ~cur->ones[j][0];
+        NRF_P1->OUTCLR = cur->all[1] & ~cur->ones[j][1];
+        while (DWT->CYCCNT - t0 < WS2812_CYCLES_T1H) {
+        }
+        NRF_P0->OUTCLR = cur->all[0];
+        NRF_P1->OUTCLR = cur->all[1];
+        ws2812_expand_bit(multi, next, k + 1, j);
+        while (DWT->CYCCNT - t0 < WS2812_CYCLES_BIT) {
+        }
+    }
+}
+
+extern "C" {
+
+int microbit_hal_pin_write_ws2812_async(int pin, const uint8_t *buf, size_t len) {
+    if (ws2812_busy || WS2812_PWM->ENABLE != PWM_ENABLE_ENABLE_Disabled) {
+        return MICROBIT_HAL_DEVICE_NO_RESOURCES;
+    }
+
+    // Drive the pin low so it stays low when the PWM releases it at the end.
+    pin_obj[pin]->setDigitalValue(0);
+
+    // Extra all-low chunks provide the reset period, and the sequences are
+    // played in pairs so round up to an even number of chunks.
+    size_t num_chunks = (len + WS2812_CHUNK_BYTES - 1) / WS2812_CHUNK_BYTES + WS2812_RESET_CHUNKS;
+    num_chunks = (num_chunks + 1) & ~1;
+
+    ws2812_src = buf;
+    ws2812_src_len = len;
+    ws2812_fill_seq(ws2812_seq[0]);
+    ws2812_fill_seq(ws2812_seq[1]);
+
+    WS2812_PWM->PSEL.OUT[0] = pin_obj[pin]->name;
+    WS2812_PWM->PSEL.OUT[1] = 0xffffffff;
+    WS2812_PWM->PSEL.OUT[2] = 0xffffffff;
+    WS2812_PWM->PSEL.OUT[3] = 0xffffffff;
+    WS2812_PWM->ENABLE = PWM_ENABLE_ENABLE_Enabled;
+    WS2812_PWM->MODE = PWM_MODE_UPDOWN_Up;
+    WS2812_PWM->PRESCALER = PWM_PRESCALER_PRESCALER_DIV_1;
+    WS2812_PWM->COUNTERTOP = WS2812_PWM_TOP;
+    WS2812_PWM->DECODER = PWM_DECODER_LOAD_Common << PWM_DECODER_LOAD_Pos
+        | PWM_DECODER_MODE_RefreshCount << PWM_DECODER_MODE_Pos;
+    for (size_t i = 0; i < 2; ++i) {
+        WS2812_PWM->SEQ[i].PTR = (uint32_t)ws2812_seq[i];
+        WS2812_PWM->SEQ[i].CNT = WS2812_CHUNK_BYTES * 8;
+        WS2812_PWM->SEQ[i].REFRESH = 0;
+        WS2812_PWM->SEQ[i].ENDDELAY = 0;
+    }
+    WS2812_PWM->LOOP = num_chunks / 2;
+    WS2812_PWM->SHORTS = PWM_SHORTS_LOOPSDONE_STOP_Msk;
+
+    WS2812_PWM->EVENTS_SEQEND[0] = 0;
+    WS2812_PWM->EVENTS_SEQEND[1] = 0;
+    WS2812_PWM->EVENTS_STOPPED = 0;
+    WS2812_PWM->INTENSET = PWM_INTENSET_SEQEND0_Msk | PWM_INTENSET_SEQEND1_Msk | PWM_INTENSET_STOPPED_Msk;
+    NVIC_SetPriority(WS2812_PWM_IRQn, WS2812_PWM_IRQ_PRIORITY);
+    NVIC_ClearPendingIRQ(WS2812_PWM_IRQn);
+    NVIC_EnableIRQ(WS2812_PWM_IRQn);
+
+    ws2812_busy = true;
+    WS2812_PWM->TASKS_SEQSTART[0] = 1;
+
+    return MICROBIT_HAL_DEVICE_OK;
+}
+
+bool microbit_hal_pin_ws2812_busy(void) {
+    return ws2812_busy;
+}
+
+void microbit_hal_pin_write_ws2812_multi(size_t n, const int *pins, const uint8_t *const *bufs, const size_t *lens) {
+    // Look up each strip's port and pin mask, and expand the first byte, before
+    // entering the timed loop.
+    ws2812_multi_t multi;
+    multi.n = n;
+    multi.bufs = bufs;
+    multi.lens = lens;
+    size_t max_len = 0;
+    for (size_t i = 0; i < n; ++i) {
+        pin_obj[pins[i]]->setDigitalValue(0);
+        int name = pin_obj[pins[i]]->name;
+        multi.ports[i] = name >> 5;
+        multi.masks[i] = 1u << (name & 31);
+        if (lens[i] > max_len) {
+            max_len = lens[i];
+        }
+    }
+    ws2812_byte_masks_t byte_masks[2];
+    for (size_t j = 0; j < 8; ++j) {
+        ws2812_expand_bit(&multi, &byte_masks[0], 0, j);
+    }
+
+    uint32_t irq_state = __get_PRIMASK();
+    __disable_irq();
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    for (size_t k = 0; k < max_len; ++k) {
+        ws2812_write_byte(&multi, &byte_masks[k & 1], &byte_masks[(k + 1) & 1], k);
+    }
+
+    __set_PRIMASK(irq_state);
+}
+
+}
@@ -2,8 +2,20 @@
 #ifndef MICROPY_INCLUDED_CODAL_APP_NEOPIXELHAL_H
 #define MICROPY_INCLUDED_CODAL_APP_NEOPIXELHAL_H
 
-void neopixel_hal_NeoPixel(int id,int pin, int len, int bytes_per_pixel, const uint8_t *buf);
+#include <stddef.h>
+#include <stdint.h>
 
-void neopixel_hal_write(int id, int length, const uint8_t *buf);
+// Pixel counts and lengths are not limited to 8 bits; strips of thousands of
+// pixels are passed through unchanged.
+
+void neopixel_hal_NeoPixel(int id, int pin, size_t len, size_t bytes_per_pixel, const uint8_t *buf);
+
+void neopixel_hal_write(int id, size_t length, const uint8_t *buf);
+
+// Only the bytes [offset, offset + length) of the strip have changed since the
+// previous write; buf points to the first of them (in wire order).  Backends
+// don't have to provide this: the weak default in neopixel.c passes the strip
+// up to offset + length to neopixel_hal_write instead.
+void neopixel_hal_write_range(int id, size_t offset, size_t length, const uint8_t *buf);
 
 #endif // MICROPY_INCLUDED_CODAL_APP_NEOPIXELHAL_H
@@ -36,6 +36,15 @@
 #define ASYNC_MODE_STOPPED 0
 #define ASYNC_MODE_ANIMATION 1
 #define ASYNC_MODE_CLEAR 2
+#define ASYNC_MODE_FRAMES 3
+#define ASYNC_MODE_CANVAS 4
+
+// State of the lookahead frame when frames are fetched by the scheduler.
+#define ASYNC_FRAME_EMPTY 0
+#define ASYNC_FRAME_READY 1
+#define ASYNC_FRAME_END 2
+
+#define DISPLAY_NUM_PIXELS (MICROBIT_DISPLAY_WIDTH * MICROBIT_DISPLAY_HEIGHT)
 
 static uint8_t async_mode;
 static mp_obj_t async_iterator = NULL;
@@ -44,9 +53,32 @@ static mp_uint_t async_delay = 1000;
 static mp_uint_t async_tick = 0;
 static bool async_clear = false;
 
+// If async_scheduled is set then the iterator may run arbitrary Python code,
+// so it is never called from the timer interrupt.  Instead the next frame is
+// fetched by the scheduler into async_frame, and the interrupt just commits it
+// to the display when it is due and schedules the fetch of the one after.
+static bool async_scheduled = false;
+static volatile uint8_t async_frame_state = ASYNC_FRAME_EMPTY;
+static bool async_fetch_scheduled = false;
+static uint8_t async_frame[DISPLAY_NUM_PIXELS];
+
+// State for ASYNC_MODE_FRAMES, playing packed greyscale frames from a buffer.
+static const uint8_t *frames_data;
+static size_t frames_stride;
+static size_t frames_count;
+static size_t frames_index;
+static uint8_t frames_width;
+static bool frames_loop;
+
+// Top-left corner of the window onto the canvas image in ASYNC_MODE_CANVAS.
+static volatile mp_int_t canvas_x;
+static volatile mp_int_t canvas_y;
+
 STATIC void async_stop(void) {
     async_iterator = NULL;
     async_mode = ASYNC_MODE_STOPPED;
+    async_scheduled = false;
+    async_frame_state = ASYNC_FRAME_EMPTY;
     async_tick = 0;
     async_delay = 1000;
     async_clear = false;
@@ -70,11 +102,146 @@ STATIC void wait_for_event() {
             mp_handle_pending(true);
             return;
         }
+        // run the scheduler, which fetches frames of the animation
+        mp_handle_pending(true);
         microbit_hal_idle();
     }
     wakeup_event = false;
 }
 
+// Unpack the 5x5 window at (x0, y0) of packed greyscale pixels into one
+// brightness level per LED.  Pixels outside the image are off.
+STATIC void render_packed(const uint8_t *data, mp_int_t width, mp_int_t height, mp_int_t x0, mp_int_t y0, uint8_t *levels) {
+    mp_int_t x_start = MAX(0, -x0);
+    mp_int_t x_end = MIN(MICROBIT_DISPLAY_WIDTH, width - x0);
+    mp_int_t y_start = MAX(0, -y0);
+    mp_int_t y_end = MIN(MICROBIT_DISPLAY_HEIGHT, height - y0);
+    memset(levels, 0, DISPLAY_NUM_PIXELS);
+    for (mp_int_t y = y_start; y < y_end; ++y) {
+        unsigned int index = (y0 + y) * width + x0 + x_start;
+        for (mp_int_t x = x_start; x < x_end; ++x, ++index) {
+            levels[y * MICROBIT_DISPLAY_WIDTH + x] = (data[index >> 1] >> ((index << 2) & 4)) & 15;
+        }
+    }
+}
+
+// Unpack an image into one brightness level per LED.
+STATIC void render_image(microbit_image_obj_t *image, uint8_t *levels) {
+    if (image->base.five) {
+        const monochrome_5by5_t *mono = &image->monochrome_5by5;
+        for (size_t i = 0; i < 24; ++i) {
+            levels[i] = (mono->bits24[i >> 3] >> (i & 7) & 1) * MICROBIT_DISPLAY_MAX_BRIGHTNESS;
+        }
+        levels[24] = mono->pixel44 * MICROBIT_DISPLAY_MAX_BRIGHTNESS;
+    } else {
+        render_packed(image->greyscale.byte_data, image->greyscale.width, image->greyscale.height, 0, 0, levels);
+    }
+}
+
+// Unpack the 5x5 window at (x0, y0) of an image into one brightness level per LED.
+STATIC void render_window(microbit_image_obj_t *image, mp_int_t x0, mp_int_t y0, uint8_t *levels) {
+    if (image->base.five) {
+        for (mp_int_t y = 0; y < MICROBIT_DISPLAY_HEIGHT; ++y) {
+            for (mp_int_t x = 0; x < MICROBIT_DISPLAY_WIDTH; ++x) {
+                mp_int_t sx = x0 + x;
+                mp_int_t sy = y0 + y;
+                bool inside = sx >= 0 && sx < MICROBIT_DISPLAY_WIDTH && sy >= 0 && sy < MICROBIT_DISPLAY_HEIGHT;
+                levels[y * MICROBIT_DISPLAY_WIDTH + x] = inside ? image_get_pixel(image, sx, sy) : 0;
+            }
+        }
+    } else {
+        render_packed(image->greyscale.byte_data, image->greyscale.width, image->greyscale.height, x0, y0, levels);
+    }
+}
+
+STATIC void canvas_show(void) {
+    uint8_t levels[DISPLAY_NUM_PIXELS];
+    render_window(MP_STATE_PORT(display_data), canvas_x, canvas_y, levels);
+    microbit_hal_display_set_frame(levels);
+}
+
+// Show the next frame of a buffer of packed frames.
+STATIC void frames_show_next(void) {
+    if (frames_index == frames_count) {
+        if (!frames_loop) {
+            async_stop();
+            return;
+        }
+        frames_index = 0;
+    }
+    uint8_t levels[DISPLAY_NUM_PIXELS];
+    render_packed(frames_data + frames_index * frames_stride, frames_width, MICROBIT_DISPLAY_HEIGHT, 0, 0, levels);
+    microbit_hal_display_set_frame(levels);
+    ++frames_index;
+}
+
+// Get the next frame of the animation into async_frame.  Called by the
+// scheduler, so the iterator is free to allocate.
+STATIC void async_fetch_frame(void) {
+    async_fetch_scheduled = false;
+    if (async_mode != ASYNC_MODE_ANIMATION || !async_scheduled || async_frame_state != ASYNC_FRAME_EMPTY
+        || MP_STATE_PORT(display_data) == NULL) {
+        return;
+    }
+    mp_obj_t obj;
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        obj = mp_iternext_allow_raise(async_iterator);
+        if (MP_OBJ_IS_STR(obj)) {
+            mp_uint_t len;
+            const char *str = mp_obj_str_get_data(obj, &len);
+            obj = len == 1 ? MP_OBJ_FROM_PTR(microbit_image_for_char(str[0])) : MP_OBJ_STOP_ITERATION;
+        }
+        nlr_pop();
+    } else {
+        if (!mp_obj_is_subclass_fast(MP_OBJ_FROM_PTR(((mp_obj_base_t*)nlr.ret_val)->type),
+            MP_OBJ_FROM_PTR(&mp_type_StopIteration))) {
+            mp_sched_exception(MP_OBJ_FROM_PTR(nlr.ret_val));
+        }
+        obj = MP_OBJ_STOP_ITERATION;
+    }
+    if (obj == MP_OBJ_STOP_ITERATION) {
+        async_frame_state = ASYNC_FRAME_END;
+    } else if (mp_obj_get_type(obj) == &microbit_image_type) {
+        render_image((microbit_image_obj_t *)obj, async_frame);
+        async_frame_state = ASYNC_FRAME_READY;
+    } else {
+        mp_sched_exception(mp_obj_new_exception_msg(&mp_type_TypeError, MP_ERROR_TEXT("not an image")));
+        async_stop();
+    }
+}
+
+STATIC mp_obj_t async_fetch_frame_wrapper(mp_obj_t arg) {
+    async_fetch_frame();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(async_fetch_frame_wrapper_obj, async_fetch_frame_wrapper);
+
+// Show the lookahead frame and request the next one.  Called from the timer interrupt.
+STATIC void async_show_frame(void) {
+    switch (async_frame_state) {
+        case ASYNC_FRAME_READY:
+            microbit_hal_display_set_frame(async_frame);
+            async_frame_state = ASYNC_FRAME_EMPTY;
+            break;
+        case ASYNC_FRAME_END:
+            if (async_clear) {
+                microbit_display_show(BLANK_IMAGE);
+                async_clear = false;
+            } else {
+                async_stop();
+            }
+            break;
+        default:
+            // The frame isn't ready yet, so show it as soon as it is.
+            async_tick = async_delay;
+            break;
+    }
+    if (async_mode == ASYNC_MODE_ANIMATION && async_frame_state == ASYNC_FRAME_EMPTY && !async_fetch_scheduled) {
+        async_fetch_scheduled = mp_sched_schedule(MP_OBJ_FROM_PTR(&async_fetch_frame_wrapper_obj), mp_const_none);
+    }
+}
+
 static void draw_object(mp_obj_t obj) {
     if (obj == MP_OBJ_STOP_ITERATION) {
         if (async_clear) {
@@ -113,6 +280,10 @@ void microbit_display_update(void) {
                 async_stop();
                 break;
             }
+            if (async_scheduled) {
+                async_show_frame();
+                break;
+            }
             mp_obj_t obj;
             nlr_buf_t nlr;
             gc_lock();
@@ -134,6 +305,20 @@ void microbit_display_update(void) {
             draw_object(obj);
             break;
         }
+        case ASYNC_MODE_FRAMES:
+            if (MP_STATE_PORT(display_data) == NULL) {
+                async_stop();
+                break;
+            }
+            frames_show_next();
+            break;
+        case ASYNC_MODE_CANVAS:
+            if (MP_STATE_PORT(display_data) == NULL) {
+                async_stop();
+                break;
+            }
+            canvas_show();
+            break;
         case ASYNC_MODE_CLEAR:
             microbit_display_show(BLANK_IMAGE);
             async_stop();
@@ -149,24 +334,9 @@ void microbit_display_clear(void) {
 }
 
 void microbit_display_show(microbit_image_obj_t *image) {
-    mp_int_t w = MIN(image_width(image), 5);
-    mp_int_t h = MIN(image_height(image), 5);
-    mp_int_t x = 0;
-    for (; x < w; ++x) {
-        mp_int_t y = 0;
-        for (; y < h; ++y) {
-            uint8_t pix = image_get_pixel(image, x, y);
-            microbit_hal_display_set_pixel(x, y, pix);
-        }
-        for (; y < 5; ++y) {
-            microbit_hal_display_set_pixel(x, y, 0);
-        }
-    }
-    for (; x < 5; ++x) {
-        for (mp_int_t y = 0; y < 5; ++y) {
-            microbit_hal_display_set_pixel(x, y, 0);
-        }
-    }
+    uint8_t levels[DISPLAY_NUM_PIXELS];
+    render_image(image, levels);
+    microbit_hal_display_set_frame(levels);
 }
 
 void microbit_display_scroll(const char *str) {
@@ -182,11 +352,71 @@ void microbit_display_animate(mp_obj_t iterable, mp_int_t delay, bool clear, boo
     async_clear = clear;
     MP_STATE_PORT(display_data) = async_iterator;
     wakeup_event = false;
+    // The port's own image iterators don't allocate and can be stepped from the
+    // timer interrupt; any other iterator is stepped by the scheduler.
+    const mp_obj_type_t *type = mp_obj_get_type(async_iterator);
+    async_scheduled = type != &microbit_scrolling_string_iterator_type && type != &microbit_facade_iterator_type;
+    async_frame_state = ASYNC_FRAME_EMPTY;
     mp_obj_t obj = mp_iternext_allow_raise(async_iterator);
     draw_object(obj);
     async_tick = 0;
     async_mode = ASYNC_MODE_ANIMATION;
+    if (async_scheduled) {
+        // Fetch the lookahead frame now, so the second frame is shown on time.
+        mp_sched_lock();
+        async_fetch_frame();
+        mp_sched_unlock();
+    }
+    if (wait) {
+        wait_for_event();
+    }
+}
+
+void microbit_display_play(mp_obj_t frames, mp_int_t width, mp_int_t delay, bool loop, bool wait) {
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(frames, &bufinfo, MP_BUFFER_READ);
+    if (width < MICROBIT_DISPLAY_WIDTH || width > 255) {
+        mp_raise_ValueError(MP_ERROR_TEXT("invalid width"));
+    }
+    size_t stride = (width * MICROBIT_DISPLAY_HEIGHT + 1) >> 1;
+    if (bufinfo.len == 0 || bufinfo.len % stride != 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("image data is incorrect size"));
+    }
+
+    // Stop anything that's running and keep a reference to the buffer while it plays.
+    async_stop();
+    frames_data = bufinfo.buf;
+    frames_stride = stride;
+    frames_count = bufinfo.len / stride;
+    frames_index = 0;
+    frames_width = width;
+    frames_loop = loop;
+    async_delay = delay;
+    MP_STATE_PORT(display_data) = frames;
+    wakeup_event = false;
+    frames_show_next();
+    async_mode = ASYNC_MODE_FRAMES;
     if (wait) {
         wait_for_event();
     }
 }
+
+void microbit_display_set_canvas(microbit_image_obj_t *image) {
+    async_stop();
+    if (image == NULL) {
+        return;
+    }
+    // Resample the canvas on every display tick so changes to it show up.
+    async_delay = MILLISECONDS_PER_MACRO_TICK;
+    MP_STATE_PORT(display_data) = image;
+    canvas_show();
+    async_mode = ASYNC_MODE_CANVAS;
+}
+
+void microbit_display_set_viewport(mp_int_t x, mp_int_t y) {
+    canvas_x = x;
+    canvas_y = y;
+    if (async_mode == ASYNC_MODE_CANVAS && MP_STATE_PORT(display_data) != NULL) {
+        canvas_show();
+    }
+}
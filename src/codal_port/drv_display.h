@@ -43,5 +43,8 @@ void microbit_display_clear(void);
 void microbit_display_show(microbit_image_obj_t *image);
 void microbit_display_scroll(const char *str);
 void microbit_display_animate(mp_obj_t iterable, mp_int_t delay, bool clear, bool wait);
+void microbit_display_play(mp_obj_t frames, mp_int_t width, mp_int_t delay, bool loop, bool wait);
+void microbit_display_set_canvas(microbit_image_obj_t *image);
+void microbit_display_set_viewport(mp_int_t x, mp_int_t y);
 
 #endif // MICROPY_INCLUDED_CODAL_PORT_DRV_DISPLAY_H
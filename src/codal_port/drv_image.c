@@ -29,6 +29,50 @@
 #include "drv_image.h"
 #include "drv_display.h"
 
+// Greyscale pixels are packed two per byte, so the kernels below work on 8
+// pixels at a time as 32-bit words.  Pixel values are at most 9, so the
+// even and odd nibbles of a word can be split into bytes and worked on with
+// room for a carry.
+#define NIBBLES_LOW (0x0f0f0f0f)
+#define BYTES_ONE (0x01010101)
+
+static inline uint32_t load_word(const uint8_t *src) {
+    uint32_t w;
+    memcpy(&w, src, sizeof(w));
+    return w;
+}
+
+static inline void store_word(uint8_t *dest, uint32_t w) {
+    memcpy(dest, &w, sizeof(w));
+}
+
+static inline size_t greyscale_num_bytes(const greyscale_t *self) {
+    return (self->width * self->height + 1) >> 1;
+}
+
+// Clamp each byte (holding a value up to 18) to at most 9.
+static inline uint32_t bytes_clamp_9(uint32_t w) {
+    uint32_t over = ((w + (0x80 - 10) * BYTES_ONE) >> 7) & BYTES_ONE;
+    uint32_t mask = over * 0xff;
+    return (w & ~mask) | (9 * BYTES_ONE & mask);
+}
+
+// Per-byte max(0, a - b) for bytes holding values up to 9.
+static inline uint32_t bytes_sub_sat(uint32_t a, uint32_t b) {
+    uint32_t d = (a | 0x10 * BYTES_ONE) - b;
+    uint32_t keep = ((d >> 4) & BYTES_ONE) * 0x0f;
+    return d & keep;
+}
+
+// If there are an odd number of pixels then the top nibble of the last byte is
+// not a pixel, keep it zero.
+static void greyscale_clear_padding(greyscale_t *self) {
+    size_t n = self->width * self->height;
+    if (n & 1) {
+        self->byte_data[n >> 1] &= 0x0f;
+    }
+}
+
 const monochrome_5by5_t microbit_blank_image = {
     { &microbit_image_type },
     1, 0, 0, 0,
@@ -103,6 +147,10 @@ greyscale_t *image_copy(microbit_image_obj_t *self) {
     mp_int_t w = image_width(self);
     mp_int_t h = image_height(self);
     greyscale_t *result = greyscale_new(w, h);
+    if (!self->base.five) {
+        memcpy(result->byte_data, self->greyscale.byte_data, greyscale_num_bytes(result));
+        return result;
+    }
     for (mp_int_t y = 0; y < h; y++) {
         for (mp_int_t x = 0; x < w; ++x) {
             greyscale_set_pixel(result, x,y, image_get_pixel(self, x,y));
@@ -112,21 +160,131 @@ greyscale_t *image_copy(microbit_image_obj_t *self) {
 }
 
 greyscale_t *image_invert(microbit_image_obj_t *self) {
-    mp_int_t w = image_width(self);
-    mp_int_t h = image_height(self);
-    greyscale_t *result = greyscale_new(w, h);
-    for (mp_int_t y = 0; y < h; y++) {
-        for (mp_int_t x = 0; x < w; ++x) {
-            greyscale_set_pixel(result,x,y, MICROBIT_DISPLAY_MAX_BRIGHTNESS - image_get_pixel(self,x,y));
-        }
+    greyscale_t *result = image_copy(self);
+    uint8_t *data = result->byte_data;
+    size_t n = greyscale_num_bytes(result);
+    size_t i = 0;
+    // No nibble is more than 9, so subtracting from all 9s never borrows.
+    for (; i + 4 <= n; i += 4) {
+        store_word(data + i, 0x99999999 - load_word(data + i));
     }
+    for (; i < n; ++i) {
+        data[i] = 0x99 - data[i];
+    }
+    greyscale_clear_padding(result);
     return result;
 }
 
+void greyscale_sum(greyscale_t *dest, const greyscale_t *lhs, const greyscale_t *rhs, bool add) {
+    const uint8_t *a = lhs->byte_data;
+    const uint8_t *b = rhs->byte_data;
+    uint8_t *d = dest->byte_data;
+    size_t n = greyscale_num_bytes(dest);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32_t wa = load_word(a + i);
+        uint32_t wb = load_word(b + i);
+        uint32_t lo, hi;
+        if (add) {
+            lo = bytes_clamp_9((wa & NIBBLES_LOW) + (wb & NIBBLES_LOW));
+            hi = bytes_clamp_9((wa >> 4 & NIBBLES_LOW) + (wb >> 4 & NIBBLES_LOW));
+        } else {
+            lo = bytes_sub_sat(wa & NIBBLES_LOW, wb & NIBBLES_LOW);
+            hi = bytes_sub_sat(wa >> 4 & NIBBLES_LOW, wb >> 4 & NIBBLES_LOW);
+        }
+        store_word(d + i, lo | hi << 4);
+    }
+    for (; i < n; ++i) {
+        int lo, hi;
+        if (add) {
+            lo = MIN((a[i] & 15) + (b[i] & 15), MICROBIT_DISPLAY_MAX_BRIGHTNESS);
+            hi = MIN((a[i] >> 4) + (b[i] >> 4), MICROBIT_DISPLAY_MAX_BRIGHTNESS);
+        } else {
+            lo = MAX(0, (a[i] & 15) - (b[i] & 15));
+            hi = MAX(0, (a[i] >> 4) - (b[i] >> 4));
+        }
+        d[i] = lo | hi << 4;
+    }
+    greyscale_clear_padding(dest);
+}
+
+void greyscale_map(greyscale_t *dest, const greyscale_t *src, const uint8_t *lut) {
+    const uint8_t *s = src->byte_data;
+    uint8_t *d = dest->byte_data;
+    size_t n = greyscale_num_bytes(dest);
+    for (size_t i = 0; i < n; ++i) {
+        d[i] = lut[s[i] & 15] | lut[s[i] >> 4] << 4;
+    }
+    greyscale_clear_padding(dest);
+}
+
+// Fill count pixels of a row starting at pixel index with zero.
+static void nibbles_clear(uint8_t *data, size_t index, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    if (index & 1) {
+        data[index >> 1] &= 0x0f;
+        ++index;
+        --count;
+    }
+    memset(data + (index >> 1), 0, count >> 1);
+    if (count & 1) {
+        data[(index + count) >> 1] &= 0xf0;
+    }
+}
+
+static inline uint8_t nibble_get(const uint8_t *data, size_t index) {
+    return (data[index >> 1] >> ((index & 1) << 2)) & 15;
+}
+
+static inline void nibble_set(uint8_t *data, size_t index, uint8_t val) {
+    unsigned int shift = (index & 1) << 2;
+    data[index >> 1] = (data[index >> 1] & (0xf0 >> shift)) | (val << shift);
+}
+
+// Copy count pixels from src to dest, where both are pixel indices into packed
+// rows.  The rows may overlap.
+static void nibbles_copy(uint8_t *dest, size_t dest_index, const uint8_t *src, size_t src_index, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    // Split into a head pixel (if dest starts on a high nibble), whole dest bytes and a tail pixel.
+    // The ends are read first, since copying the middle may overwrite them.
+    size_t head = dest_index & 1;
+    size_t num_bytes = (count - head) >> 1;
+    size_t tail = (count - head) & 1;
+    uint8_t head_val = head ? nibble_get(src, src_index) : 0;
+    uint8_t tail_val = tail ? nibble_get(src, src_index + count - 1) : 0;
+
+    uint8_t *d = dest + ((dest_index + head) >> 1);
+    size_t s_index = src_index + head;
+    const uint8_t *s = src + (s_index >> 1);
+    if ((s_index & 1) == 0) {
+        memmove(d, s, num_bytes);
+    } else if (d <= s) {
+        // Each dest byte takes the high nibble of one src byte and the low nibble of the next.
+        for (size_t i = 0; i < num_bytes; ++i) {
+            d[i] = (s[i] >> 4) | (s[i + 1] << 4);
+        }
+    } else {
+        for (size_t i = num_bytes; i-- > 0;) {
+            d[i] = (s[i] >> 4) | (s[i + 1] << 4);
+        }
+    }
+
+    if (head) {
+        nibble_set(dest, dest_index, head_val);
+    }
+    if (tail) {
+        nibble_set(dest, dest_index + count - 1, tail_val);
+    }
+}
+
 static void clear_rect(greyscale_t *img, mp_int_t x0, mp_int_t y0,mp_int_t x1, mp_int_t y1) {
-    for (int i = x0; i < x1; ++i) {
-        for (int j = y0; j < y1; ++j) {
-            greyscale_set_pixel(img, i, j, 0);
+    for (int j = y0; j < y1; ++j) {
+        if (x1 > x0) {
+            nibbles_clear(img->byte_data, j * img->width + x0, x1 - x0);
         }
     }
 }
@@ -138,8 +296,8 @@ void image_blit(microbit_image_obj_t *src, greyscale_t *dest, mp_int_t x, mp_int
     if (h < 0) {
         h = 0;
     }
-    mp_int_t intersect_x0 = MAX(MAX(0, x), -xdest);
-    mp_int_t intersect_y0 = MAX(MAX(0, y), -ydest);
+    mp_int_t intersect_x0 = MAX(MAX(0, x), x - xdest);
+    mp_int_t intersect_y0 = MAX(MAX(0, y), y - ydest);
     mp_int_t intersect_x1 = MIN(MIN(dest->width+x-xdest, image_width(src)), x+w);
     mp_int_t intersect_y1 = MIN(MIN(dest->height+y-ydest, image_height(src)), y+h);
     mp_int_t xstart, xend, ystart, yend, xdel, ydel;
@@ -162,10 +320,21 @@ void image_blit(microbit_image_obj_t *src, greyscale_t *dest, mp_int_t x, mp_int
     } else {
         ystart = intersect_y1 - 1; yend = intersect_y0 - 1; ydel = -1;
     }
-    for (int i = xstart; i != xend; i += xdel) {
+    if (src->base.five) {
+        for (int i = xstart; i != xend; i += xdel) {
+            for (int j = ystart; j != yend; j += ydel) {
+                int val = image_get_pixel(src, i, j);
+                greyscale_set_pixel(dest, i+xdest-x, j+ydest-y, val);
+            }
+        }
+    } else {
+        // Copy a row at a time, in an order that is safe if src and dest are the same image.
+        mp_int_t x0 = MIN(xstart, xend - xdel);
+        mp_int_t count = MAX(xstart, xend - xdel) - x0 + 1;
+        const uint8_t *src_data = src->greyscale.byte_data;
         for (int j = ystart; j != yend; j += ydel) {
-            int val = image_get_pixel(src, i, j);
-            greyscale_set_pixel(dest, i+xdest-x, j+ydest-y, val);
+            nibbles_copy(dest->byte_data, (j + ydest - y) * dest->width + x0 + xdest - x,
+                src_data, j * src->greyscale.width + x0, count);
         }
     }
     // Adjust intersection rectange to dest
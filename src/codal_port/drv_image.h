@@ -76,6 +76,8 @@ typedef union _microbit_image_obj_t {
 
 extern const mp_obj_type_t microbit_const_image_type;
 extern const mp_obj_type_t microbit_image_type;
+extern const mp_obj_type_t microbit_scrolling_string_iterator_type;
+extern const mp_obj_type_t microbit_facade_iterator_type;
 
 extern const monochrome_5by5_t microbit_blank_image;
 extern const monochrome_5by5_t microbit_const_image_heart_obj;
@@ -85,6 +87,9 @@ void greyscale_clear(greyscale_t *self);
 void greyscale_fill(greyscale_t *self, mp_int_t val);
 uint8_t greyscale_get_pixel(greyscale_t *self, mp_int_t x, mp_int_t y);
 void greyscale_set_pixel(greyscale_t *self, mp_int_t x, mp_int_t y, mp_int_t val);
+void greyscale_sum(greyscale_t *dest, const greyscale_t *lhs, const greyscale_t *rhs, bool add);
+// Map each pixel of src through a 16-entry table into dest.
+void greyscale_map(greyscale_t *dest, const greyscale_t *src, const uint8_t *lut);
 
 mp_int_t image_width(microbit_image_obj_t *self);
 mp_int_t image_height(microbit_image_obj_t *self);
@@ -30,19 +30,100 @@
 #include "py/runtime.h"
 #include "py/mphal.h"
 #include "drv_radio.h"
+#include "codal_app/microbithal.h"
 
 #define RADIO_PACKET_OVERHEAD (1 + 1 + 4) // 1 byte for len, 1 byte for RSSI, 4 bytes for time
 
-static uint8_t *rx_buf_end = NULL; // pointer to the end of the allocated RX queue
-static uint8_t *rx_buf = NULL; // pointer to last packet on the RX queue
+// The RX queue is a ring of fixed-size slots following the tx/rx buffer.  The
+// IRQ handler is the only writer of rx_head and the reader (peek/pop) is the
+// only writer of rx_tail, so no locking is needed between them.  Both count
+// modulo 2 * rx_queue_len, which tells a full queue from an empty one for any
+// queue length; the slot is the count modulo rx_queue_len.
+static uint8_t *rx_queue = NULL; // first slot of the RX queue
+static size_t rx_slot_size; // size of a slot, big enough for a packet and its overhead
+static size_t rx_queue_len; // number of slots in the RX queue
+static volatile uint32_t rx_head; // packets put on the RX queue, modulo 2 * rx_queue_len
+static volatile uint32_t rx_tail; // packets taken off the RX queue, modulo 2 * rx_queue_len
+
+// The TX queue is a ring of MICROBIT_RADIO_TX_QUEUE_LEN slots, the same size as
+// the RX slots, after the RX queue.  send() fills the slot at tx_head and the
+// IRQ handler transmits straight from the slot at tx_tail.
+static volatile uint32_t tx_head; // number of packets put on the TX queue
+static volatile uint32_t tx_tail; // number of packets sent from the TX queue
+static volatile bool tx_active; // radio is switched away from RX to send the TX queue
+static volatile bool tx_sending; // radio is transmitting the packet at tx_tail
+
+// Packets that don't match the filter are dropped by the IRQ handler before
+// they reach the RX queue.  A length of 0 accepts packets of any length.
+static uint8_t rx_filter_prefix[MICROBIT_RADIO_FILTER_PREFIX_MAX];
+static uint8_t rx_filter_prefix_len;
+static uint8_t rx_filter_len;
+
+// Set when a call to the receive callback is scheduled, so that packets arriving
+// before it runs share one call.
+static volatile bool rx_callback_scheduled;
+
+// How long to wait for the TX queue to drain before turning the radio off or
+// reconfiguring it; enough for a full queue of maximum-size packets at 250Kbit.
+#define RADIO_TX_FLUSH_TIMEOUT_MS (100)
+
+#define RADIO_TX_SHORTS (RADIO_SHORTS_READY_START_Msk | RADIO_SHORTS_END_DISABLE_Msk)
+
+static inline uint8_t *rx_slot(uint32_t n) {
+    return rx_queue + (n >= rx_queue_len ? n - rx_queue_len : n) * rx_slot_size;
+}
 
-void microbit_radio_irq_handler(void) {
-    if (NRF_RADIO->EVENTS_READY) {
-        NRF_RADIO->EVENTS_READY = 0;
-        NRF_RADIO->TASKS_START = 1;
+static inline uint32_t rx_next(uint32_t n) {
+    return n + 1 == 2 * rx_queue_len ? 0 : n + 1;
+}
+
+static inline uint32_t rx_count(uint32_t head, uint32_t tail) {
+    return head >= tail ? head - tail : head + 2 * rx_queue_len - tail;
+}
+
+static inline uint8_t *tx_slot(uint32_t n) {
+    return rx_queue + (rx_queue_len + n % MICROBIT_RADIO_TX_QUEUE_LEN) * rx_slot_size;
+}
+
+// Wait a bounded time for the IRQ handler to send everything on the TX queue,
+// then disable the radio IRQ and drop whatever is left.  On return the radio is
+// set up to receive again.
+static void tx_flush(void) {
+    uint32_t start = mp_hal_ticks_ms();
+    while (tx_head != tx_tail && mp_hal_ticks_ms() - start < RADIO_TX_FLUSH_TIMEOUT_MS) {
+        microbit_hal_idle();
+    }
+    NVIC_DisableIRQ(RADIO_IRQn);
+    tx_tail = tx_head;
+    tx_active = false;
+    tx_sending = false;
+    NRF_RADIO->SHORTS &= ~RADIO_SHORTS_END_DISABLE_Msk;
+    NRF_RADIO->PACKETPTR = (uint32_t)MP_STATE_PORT(radio_buf);
+}
+
+static bool rx_filter_accept(const uint8_t *data, size_t len) {
+    if (rx_filter_len != 0 && len != rx_filter_len) {
+        return false;
     }
+    return len >= rx_filter_prefix_len && memcmp(data, rx_filter_prefix, rx_filter_prefix_len) == 0;
+}
 
-    if (NRF_RADIO->EVENTS_END) {
+// Called by the scheduler after packets are put on the RX queue.
+STATIC mp_obj_t rx_callback_wrapper(mp_obj_t arg) {
+    (void)arg;
+    rx_callback_scheduled = false;
+    mp_obj_t callback = MP_STATE_PORT(radio_receive_callback);
+    if (callback != MP_OBJ_NULL) {
+        mp_call_function_0(callback);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(rx_callback_wrapper_obj, rx_callback_wrapper);
+
+void microbit_radio_irq_handler(void) {
+    // START after READY is done by the READY_START short, for both RX and TX.
+
+    if (NRF_RADIO->EVENTS_END && !tx_sending) {
         NRF_RADIO->EVENTS_END = 0;
 
         size_t max_len = NRF_RADIO->PCNF1 & 0xff;
@@ -53,8 +134,12 @@ void microbit_radio_irq_handler(void) {
             pkt[0] = len;
         }
 
-        // if the CRC was valid, and there's enough room in the RX queue, then accept the packet
-        if (NRF_RADIO->CRCSTATUS == 1 && rx_buf + RADIO_PACKET_OVERHEAD + len <= rx_buf_end) {
+        // if the CRC was valid, the packet passes the filter, and there's a free
+        // slot in the RX queue, then accept the packet
+        uint32_t head = rx_head;
+        if (NRF_RADIO->CRCSTATUS == 1 && rx_filter_accept(pkt + 1, len) && rx_count(head, rx_tail) < rx_queue_len) {
+            uint8_t *rx_buf = rx_slot(head);
+
             // copy the data to the queue
             memcpy(rx_buf, pkt, 1 + len);
 
@@ -68,11 +153,49 @@ void microbit_radio_irq_handler(void) {
             rx_buf[1 + len + 3] = (time >> 16) & 0xff;
             rx_buf[1 + len + 4] = (time >> 24) & 0xff;
 
-            // move the RX queue pointer to end of this new packet
-            rx_buf += RADIO_PACKET_OVERHEAD + len;
+            // publish the packet to the reader once it's completely written
+            __DMB();
+            rx_head = rx_next(head);
+
+            // tell Python about it, unless a call is already pending
+            if (MP_STATE_PORT(radio_receive_callback) != MP_OBJ_NULL && !rx_callback_scheduled) {
+                rx_callback_scheduled = mp_sched_schedule(MP_OBJ_FROM_PTR(&rx_callback_wrapper_obj), mp_const_none);
+            }
         }
 
-        NRF_RADIO->TASKS_START = 1;
+        // keep listening, unless the radio is being switched over to send
+        if (!tx_active) {
+            NRF_RADIO->TASKS_START = 1;
+        }
+    }
+
+    if (NRF_RADIO->EVENTS_END) {
+        // A transmitted packet ended, and the END_DISABLE short turns off the transmitter.
+        NRF_RADIO->EVENTS_END = 0;
+    }
+
+    if (NRF_RADIO->EVENTS_DISABLED) {
+        NRF_RADIO->EVENTS_DISABLED = 0;
+
+        if (tx_active) {
+            if (tx_sending) {
+                tx_tail = tx_tail + 1;
+            }
+            if (tx_head != tx_tail) {
+                // Send the next packet; the READY_START short starts it once the transmitter is up.
+                NRF_RADIO->PACKETPTR = (uint32_t)tx_slot(tx_tail);
+                NRF_RADIO->SHORTS |= RADIO_TX_SHORTS;
+                tx_sending = true;
+                NRF_RADIO->TASKS_TXEN = 1;
+            } else {
+                // TX queue is empty, go back to listening.
+                NRF_RADIO->SHORTS &= ~RADIO_SHORTS_END_DISABLE_Msk;
+                NRF_RADIO->PACKETPTR = (uint32_t)MP_STATE_PORT(radio_buf);
+                tx_sending = false;
+                tx_active = false;
+                NRF_RADIO->TASKS_RXEN = 1;
+            }
+        }
     }
 }
 
@@ -80,11 +203,17 @@ void microbit_radio_enable(microbit_radio_config_t *config) {
     microbit_radio_disable();
 
     // allocate tx and rx buffers
-    size_t max_payload = config->max_payload + RADIO_PACKET_OVERHEAD;
-    size_t queue_len = config->queue_len + 1; // one extra for tx/rx buffer
-    MP_STATE_PORT(radio_buf) = m_new(uint8_t, max_payload * queue_len);
-    rx_buf_end = MP_STATE_PORT(radio_buf) + max_payload * queue_len;
-    rx_buf = MP_STATE_PORT(radio_buf) + max_payload; // start is tx/rx buffer
+    rx_slot_size = config->max_payload + RADIO_PACKET_OVERHEAD;
+    rx_queue_len = config->queue_len;
+    // one extra for the rx buffer, plus the TX queue
+    MP_STATE_PORT(radio_buf) = m_new(uint8_t, rx_slot_size * (1 + rx_queue_len + MICROBIT_RADIO_TX_QUEUE_LEN));
+    rx_queue = MP_STATE_PORT(radio_buf) + rx_slot_size; // start is rx buffer
+    rx_head = 0;
+    rx_tail = 0;
+    tx_head = 0;
+    tx_tail = 0;
+    tx_active = false;
+    tx_sending = false;
 
     // Enable the High Frequency clock on the processor. This is a pre-requisite for
     // the RADIO module. Without this clock, no communication is possible.
@@ -128,25 +257,23 @@ void microbit_radio_enable(microbit_radio_config_t *config) {
     // Set the tx/rx packet buffer (must be in RAM).
     NRF_RADIO->PACKETPTR = (uint32_t)MP_STATE_PORT(radio_buf);
 
-    // configure interrupts
-    NRF_RADIO->INTENSET = 0x00000008;
+    // configure interrupts for END and DISABLED
+    NRF_RADIO->INTENSET = RADIO_INTENSET_END_Msk | RADIO_INTENSET_DISABLED_Msk;
     NVIC_SetPriority(RADIO_IRQn, 3);
     NVIC_ClearPendingIRQ(RADIO_IRQn);
     NVIC_EnableIRQ(RADIO_IRQn);
 
-    NRF_RADIO->SHORTS |= RADIO_SHORTS_ADDRESS_RSSISTART_Msk;
-
-    // enable receiver
-    NRF_RADIO->EVENTS_READY = 0;
-    NRF_RADIO->TASKS_RXEN = 1;
-    while (NRF_RADIO->EVENTS_READY == 0) {
-    }
+    NRF_RADIO->SHORTS = RADIO_SHORTS_ADDRESS_RSSISTART_Msk | RADIO_SHORTS_READY_START_Msk;
 
+    // enable receiver, the READY_START short starts listening once it's up
     NRF_RADIO->EVENTS_END = 0;
-    NRF_RADIO->TASKS_START = 1;
+    NRF_RADIO->TASKS_RXEN = 1;
 }
 
 void microbit_radio_disable(void) {
+    if (MP_STATE_PORT(radio_buf) != NULL) {
+        tx_flush();
+    }
     NVIC_DisableIRQ(RADIO_IRQn);
     NRF_RADIO->EVENTS_DISABLED = 0;
     NRF_RADIO->TASKS_DISABLE = 1;
@@ -155,13 +282,27 @@ void microbit_radio_disable(void) {
 
     // free any old buffers
     if (MP_STATE_PORT(radio_buf) != NULL) {
-        m_del(uint8_t, MP_STATE_PORT(radio_buf), rx_buf_end - MP_STATE_PORT(radio_buf));
+        m_del(uint8_t, MP_STATE_PORT(radio_buf), rx_slot_size * (1 + rx_queue_len + MICROBIT_RADIO_TX_QUEUE_LEN));
         MP_STATE_PORT(radio_buf) = NULL;
+        rx_queue = NULL;
+    }
+}
+
+// Called on soft reset, before the GC heap is reinitialised: turn the radio off
+// and drop everything that refers to the heap, so the IRQ can't use it.
+void microbit_radio_deinit(void) {
+    if (MP_STATE_PORT(radio_buf) != NULL) {
+        microbit_radio_disable();
     }
+    MP_STATE_PORT(radio_receive_callback) = MP_OBJ_NULL;
+    MP_STATE_PORT(radio_large_msgs) = NULL;
+    rx_callback_scheduled = false;
+    microbit_radio_set_filter(NULL, 0, 0);
 }
 
 void microbit_radio_update_config(microbit_radio_config_t *config) {
-    // disable radio
+    // disable radio, once any queued packets are sent
+    tx_flush();
     NVIC_DisableIRQ(RADIO_IRQn);
     NRF_RADIO->EVENTS_DISABLED = 0;
     NRF_RADIO->TASKS_DISABLE = 1;
@@ -175,33 +316,26 @@ void microbit_radio_update_config(microbit_radio_config_t *config) {
     NRF_RADIO->BASE0 = config->base0;
     NRF_RADIO->PREFIX0 = config->prefix0;
 
-    // need to set RXEN for FREQUENCY decision point
-    NRF_RADIO->EVENTS_READY = 0;
-    NRF_RADIO->TASKS_RXEN = 1;
-    while (NRF_RADIO->EVENTS_READY == 0) {
-    }
-
-    // need to set START for BASE0 and PREFIX0 decision point
+    // need to set RXEN for FREQUENCY decision point, and the START that the
+    // READY_START short then triggers is the BASE0 and PREFIX0 decision point
     NRF_RADIO->EVENTS_END = 0;
-    NRF_RADIO->TASKS_START = 1;
+    NRF_RADIO->TASKS_RXEN = 1;
 
     NVIC_ClearPendingIRQ(RADIO_IRQn);
     NVIC_EnableIRQ(RADIO_IRQn);
 }
 
 // This assumes the radio is enabled.
-void microbit_radio_send(const void *buf, size_t len, const void *buf2, size_t len2) {
-    // transmission will occur synchronously
-    NVIC_DisableIRQ(RADIO_IRQn);
-
-    // Turn off the transceiver.
-    NRF_RADIO->EVENTS_DISABLED = 0;
-    NRF_RADIO->TASKS_DISABLE = 1;
-    while (NRF_RADIO->EVENTS_DISABLED == 0) {
+void microbit_radio_send(const void *buf, size_t len, const void *buf2, size_t len2, bool wait) {
+    // wait for a free slot on the TX queue
+    while (tx_head - tx_tail >= MICROBIT_RADIO_TX_QUEUE_LEN) {
+        mp_handle_pending(true);
+        microbit_hal_idle();
     }
 
-    // construct the packet
-    // note: we must send from RAM
+    // construct the packet in its TX slot, which the radio sends from directly
+    uint32_t head = tx_head;
+    uint8_t *pkt = tx_slot(head);
     size_t max_len = NRF_RADIO->PCNF1 & 0xff;
     if (len + len2 > max_len) {
         if (len > max_len) {
@@ -211,75 +345,67 @@ void microbit_radio_send(const void *buf, size_t len, const void *buf2, size_t l
             len2 = max_len - len;
         }
     }
-    MP_STATE_PORT(radio_buf)[0] = len + len2;
-    memcpy(MP_STATE_PORT(radio_buf) + 1, buf, len);
+    pkt[0] = len + len2;
+    memcpy(pkt + 1, buf, len);
     if (len2 != 0) {
-        memcpy(MP_STATE_PORT(radio_buf) + 1 + len, buf2, len2);
-    }
-
-    // Turn on the transmitter, and wait for it to signal that it's ready to use.
-    NRF_RADIO->EVENTS_READY = 0;
-    NRF_RADIO->TASKS_TXEN = 1;
-    while (NRF_RADIO->EVENTS_READY == 0) {
+        memcpy(pkt + 1 + len, buf2, len2);
     }
 
-    // Start transmission and wait for end of packet.
-    NRF_RADIO->TASKS_START = 1;
-    NRF_RADIO->EVENTS_END = 0;
-    while (NRF_RADIO->EVENTS_END == 0) {
+    // Queue the packet, and if the radio is listening then turn off the receiver
+    // so the IRQ handler starts sending the queue.
+    NVIC_DisableIRQ(RADIO_IRQn);
+    tx_head = head + 1;
+    if (!tx_active) {
+        tx_active = true;
+        tx_sending = false;
+        NRF_RADIO->TASKS_DISABLE = 1;
     }
+    NVIC_EnableIRQ(RADIO_IRQn);
 
-    // Turn off the transmitter.
-    NRF_RADIO->EVENTS_DISABLED = 0;
-    NRF_RADIO->TASKS_DISABLE = 1;
-    while (NRF_RADIO->EVENTS_DISABLED == 0) {
+    if (wait) {
+        while ((int32_t)(tx_tail - head) <= 0) {
+            mp_handle_pending(true);
+            microbit_hal_idle();
+        }
     }
+}
 
-    // Start listening for the next packet
-    NRF_RADIO->EVENTS_READY = 0;
-    NRF_RADIO->TASKS_RXEN = 1;
-    while (NRF_RADIO->EVENTS_READY == 0) {
+size_t microbit_radio_tx_pending(void) {
+    if (MP_STATE_PORT(radio_buf) == NULL) {
+        return 0;
     }
-
-    NRF_RADIO->EVENTS_END = 0;
-    NRF_RADIO->TASKS_START = 1;
-
-    NVIC_ClearPendingIRQ(RADIO_IRQn);
-    NVIC_EnableIRQ(RADIO_IRQn);
+    return tx_head - tx_tail;
 }
 
 const uint8_t *microbit_radio_peek(void) {
-    // Disable the radio IRQ while we peek for packet.
-    NVIC_DisableIRQ(RADIO_IRQn);
-
-    // Get the pointer to the next waiting packet.
-    const uint8_t *buf = MP_STATE_PORT(radio_buf) + (NRF_RADIO->PCNF1 & 0xff) + RADIO_PACKET_OVERHEAD; // skip tx buf
-
     // Return NULL if there are no packets waiting.
-    if (rx_buf == buf) {
-        buf = NULL;
+    if (rx_queue == NULL || rx_tail == rx_head) {
+        return NULL;
     }
-
-    // Re-enable the radio IRQ.
-    NVIC_EnableIRQ(RADIO_IRQn);
-
-    return buf;
+    return rx_slot(rx_tail);
 }
 
 void microbit_radio_pop(void) {
-    // Disable the radio IRQ while we pop the packet.
-    NVIC_DisableIRQ(RADIO_IRQn);
-
-    // Get the pointer to the next packet, skipping the TX buffer at the start.
-    uint8_t *buf = MP_STATE_PORT(radio_buf) + (NRF_RADIO->PCNF1 & 0xff) + RADIO_PACKET_OVERHEAD;
-
-    if (rx_buf != buf) {
-        // Copy all subsequent packets down over the first one.
-        size_t len = buf[0];
-        memmove(buf, buf + RADIO_PACKET_OVERHEAD + len, rx_buf - (buf + RADIO_PACKET_OVERHEAD + len));
-        rx_buf -= RADIO_PACKET_OVERHEAD + len;
+    uint32_t tail = rx_tail;
+    if (rx_queue != NULL && tail != rx_head) {
+        // Make sure the reader is finished with the slot before the IRQ can reuse it.
+        __DMB();
+        rx_tail = rx_next(tail);
     }
+}
 
-    // Re-enable the radio IRQ.
-    NVIC_EnableIRQ(RADIO_IRQn);
+void microbit_radio_set_filter(const uint8_t *prefix, size_t prefix_len, size_t len) {
+    // Don't let the IRQ handler see a half-updated filter.
+    bool enabled = MP_STATE_PORT(radio_buf) != NULL;
+    if (enabled) {
+        NVIC_DisableIRQ(RADIO_IRQn);
+    }
+    if (prefix_len != 0) {
+        memcpy(rx_filter_prefix, prefix, prefix_len);
+    }
+    rx_filter_prefix_len = prefix_len;
+    rx_filter_len = len;
+    if (enabled) {
+        NVIC_EnableIRQ(RADIO_IRQn);
+    }
 }
@@ -26,7 +26,7 @@
 #ifndef MICROPY_INCLUDED_CODAL_PORT_DRV_RADIO_H
 #define MICROPY_INCLUDED_CODAL_PORT_DRV_RADIO_H
 
-// Packets are stored in the queue as a sequence of bytes of the form:
+// Each packet is stored in its own slot of the RX queue as bytes of the form:
 //  len  - byte
 //  data - "len" bytes
 //  RSSI - byte
@@ -51,6 +51,9 @@
 #define MICROBIT_RADIO_DEFAULT_PREFIX0      (0)
 #define MICROBIT_RADIO_DEFAULT_DATA_RATE    (RADIO_MODE_MODE_Nrf_1Mbit)
 
+#define MICROBIT_RADIO_TX_QUEUE_LEN         (4)
+#define MICROBIT_RADIO_FILTER_PREFIX_MAX    (8)
+
 #define MICROBIT_RADIO_MAX_CHANNEL          (83) // maximum allowed frequency is 2483.5 MHz
 
 typedef struct _microbit_radio_config_t {
@@ -65,9 +68,12 @@ typedef struct _microbit_radio_config_t {
 
 void microbit_radio_enable(microbit_radio_config_t *config);
 void microbit_radio_disable(void);
+void microbit_radio_deinit(void);
 void microbit_radio_update_config(microbit_radio_config_t *config);
-void microbit_radio_send(const void *buf, size_t len, const void *buf2, size_t len2);
+void microbit_radio_send(const void *buf, size_t len, const void *buf2, size_t len2, bool wait);
+size_t microbit_radio_tx_pending(void);
 const uint8_t *microbit_radio_peek(void);
 void microbit_radio_pop(void);
+void microbit_radio_set_filter(const uint8_t *prefix, size_t prefix_len, size_t len);
 
 #endif // MICROPY_INCLUDED_CODAL_PORT_DRV_RADIO_H
@@ -40,6 +40,7 @@
 #include "drv_softtimer.h"
 #include "drv_system.h"
 #include "drv_display.h"
+#include "drv_radio.h"
 #include "modmicrobit.h"
 
 #define MAIN_PY "main.py"
@@ -91,6 +92,7 @@ void mp_main(void) {
 
         mp_printf(MP_PYTHON_PRINTER, "MPY: soft reboot\n");
         microbit_soft_timer_deinit();
+        microbit_radio_deinit();
         gc_sweep_all();
         mp_deinit();
     }
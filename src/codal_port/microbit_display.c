@@ -31,6 +31,7 @@
 #include "modmicrobit.h"
 
 #define DEFAULT_PRINT_SPEED_MS 400
+#define DEFAULT_PLAY_FPS 10
 
 typedef struct _microbit_display_obj_t {
     mp_obj_base_t base;
@@ -122,6 +123,50 @@ mp_obj_t microbit_display_scroll_func(mp_uint_t n_args, const mp_obj_t *pos_args
 }
 MP_DEFINE_CONST_FUN_OBJ_KW(microbit_display_scroll_obj, 1, microbit_display_scroll_func);
 
+mp_obj_t microbit_display_play_func(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_frames, ARG_width, ARG_fps, ARG_loop, ARG_wait };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_frames, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_width, MP_ARG_INT, {.u_int = MICROBIT_DISPLAY_WIDTH} },
+        { MP_QSTR_fps, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_rom_obj = MP_ROM_INT(DEFAULT_PLAY_FPS)} },
+        { MP_QSTR_loop, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = true} },
+        { MP_QSTR_wait, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+    };
+    // Parse the args.
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+    mp_float_t fps = mp_obj_get_float(args[ARG_fps].u_obj);
+    if (fps <= 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("fps must be positive"));
+    }
+    if (args[ARG_loop].u_bool && args[ARG_wait].u_bool) {
+        mp_raise_ValueError(MP_ERROR_TEXT("can't wait for a looping animation"));
+    }
+    microbit_display_play(args[ARG_frames].u_obj, args[ARG_width].u_int, (mp_int_t)(1000 / fps), args[ARG_loop].u_bool, args[ARG_wait].u_bool);
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(microbit_display_play_obj, 1, microbit_display_play_func);
+
+STATIC mp_obj_t microbit_display_set_canvas_func(mp_obj_t self_in, mp_obj_t image_in) {
+    (void)self_in;
+    if (image_in == mp_const_none) {
+        microbit_display_set_canvas(NULL);
+    } else if (mp_obj_get_type(image_in) == &microbit_image_type) {
+        microbit_display_set_canvas(MP_OBJ_TO_PTR(image_in));
+    } else {
+        mp_raise_TypeError(MP_ERROR_TEXT("expecting an image"));
+    }
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_2(microbit_display_set_canvas_obj, microbit_display_set_canvas_func);
+
+STATIC mp_obj_t microbit_display_set_viewport_func(mp_obj_t self_in, mp_obj_t x_in, mp_obj_t y_in) {
+    (void)self_in;
+    microbit_display_set_viewport(mp_obj_get_int(x_in), mp_obj_get_int(y_in));
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_3(microbit_display_set_viewport_obj, microbit_display_set_viewport_func);
+
 mp_obj_t microbit_display_on_func(mp_obj_t self_in) {
     microbit_display_obj_t *self = MP_OBJ_TO_PTR(self_in);
     microbit_obj_pin_acquire(&microbit_p3_obj, microbit_pin_mode_display);
@@ -204,6 +249,9 @@ STATIC const mp_rom_map_elem_t microbit_display_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_set_pixel), MP_ROM_PTR(&microbit_display_set_pixel_obj) },
     { MP_ROM_QSTR(MP_QSTR_show), MP_ROM_PTR(&microbit_display_show_obj) },
     { MP_ROM_QSTR(MP_QSTR_scroll), MP_ROM_PTR(&microbit_display_scroll_obj) },
+    { MP_ROM_QSTR(MP_QSTR_play), MP_ROM_PTR(&microbit_display_play_obj) },
+    { MP_ROM_QSTR(MP_QSTR_set_canvas), MP_ROM_PTR(&microbit_display_set_canvas_obj) },
+    { MP_ROM_QSTR(MP_QSTR_set_viewport), MP_ROM_PTR(&microbit_display_set_viewport_obj) },
     { MP_ROM_QSTR(MP_QSTR_clear), MP_ROM_PTR(&microbit_display_clear_obj) },
     { MP_ROM_QSTR(MP_QSTR_on), MP_ROM_PTR(&microbit_display_on_obj) },
     { MP_ROM_QSTR(MP_QSTR_off), MP_ROM_PTR(&microbit_display_off_obj) },
@@ -25,6 +25,7 @@
  * THE SOFTWARE.
  */
 
+#include <string.h>
 #include "py/runtime.h"
 #include "py/mphal.h"
 #include "modmicrobit.h"
@@ -435,13 +436,99 @@ STATIC mp_int_t get_pixel_from_font_data(const unsigned char *data, int x, int y
     return ((data[y] >> (4 - x)) & 1);
 }
 
-STATIC void microbit_image_set_from_char(greyscale_t *img, char c) {
+STATIC int font_column_non_blank(const unsigned char *font_data, unsigned int col) {
+    for (int y = 0; y < MICROBIT_DISPLAY_HEIGHT; ++y) {
+        if (get_pixel_from_font_data(font_data, col, y)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Not strictly the rightmost non-blank column, but the rightmost in columns 2,3 or 4. */
+STATIC unsigned int rightmost_non_blank_column(const unsigned char *font_data) {
+    if (font_column_non_blank(font_data, 4)) {
+        return 4;
+    }
+    if (font_column_non_blank(font_data, 3)) {
+        return 3;
+    }
+    return 2;
+}
+
+// A glyph of the system font in the forms needed to draw it: rows as in the
+// font data (bit 4 is the leftmost pixel), columns (bit y is row y), whether
+// the first column has any pixels set, and the proportional width.
+typedef struct _font_glyph_t {
+    uint8_t rows[MICROBIT_DISPLAY_HEIGHT];
+    uint8_t columns[MICROBIT_DISPLAY_WIDTH];
+    uint8_t lead;
+    uint8_t width;
+} font_glyph_t;
+
+#define FONT_GLYPH_FIRST (32)
+#define FONT_GLYPH_LAST (126)
+#define FONT_GLYPH_COUNT (FONT_GLYPH_LAST - FONT_GLYPH_FIRST + 1)
+
+// Glyphs are filled in from the CODAL font on first use.
+STATIC font_glyph_t font_glyph_cache[FONT_GLYPH_COUNT];
+STATIC uint32_t font_glyph_cached[(FONT_GLYPH_COUNT + 31) / 32];
+
+// Packed greyscale nibbles for each 5-pixel font row, at full brightness.
+STATIC const uint32_t font_row_nibbles[32] = {
+    0x00000, 0x90000, 0x09000, 0x99000,
+    0x00900, 0x90900, 0x09900, 0x99900,
+    0x00090, 0x90090, 0x09090, 0x99090,
+    0x00990, 0x90990, 0x09990, 0x99990,
+    0x00009, 0x90009, 0x09009, 0x99009,
+    0x00909, 0x90909, 0x09909, 0x99909,
+    0x00099, 0x90099, 0x09099, 0x99099,
+    0x00999, 0x90999, 0x09999, 0x99999,
+};
+
+STATIC void font_glyph_fill(font_glyph_t *glyph, char c) {
     const unsigned char *data = get_font_data_from_char(c);
-    for (int x = 0; x < MICROBIT_DISPLAY_WIDTH; ++x) {
-        for (int y = 0; y < MICROBIT_DISPLAY_HEIGHT; ++y) {
-            greyscale_set_pixel(img, x, y, get_pixel_from_font_data(data, x, y)*MICROBIT_DISPLAY_MAX_BRIGHTNESS);
+    memset(glyph->columns, 0, sizeof(glyph->columns));
+    for (int y = 0; y < MICROBIT_DISPLAY_HEIGHT; ++y) {
+        glyph->rows[y] = data[y] & 0x1f;
+        for (int x = 0; x < MICROBIT_DISPLAY_WIDTH; ++x) {
+            glyph->columns[x] |= get_pixel_from_font_data(data, x, y) << y;
+        }
+    }
+    glyph->lead = font_column_non_blank(data, 0);
+    glyph->width = rightmost_non_blank_column(data) + 1;
+}
+
+// Get the glyph for a character.  This may be called from the display interrupt,
+// in which case it may race with a fill of the same entry; both write the same data.
+STATIC void get_font_glyph(char c, font_glyph_t *glyph) {
+    unsigned int index = (unsigned char)c - FONT_GLYPH_FIRST;
+    if (index >= FONT_GLYPH_COUNT) {
+        font_glyph_fill(glyph, c);
+        return;
+    }
+    if (!(font_glyph_cached[index >> 5] & (1u << (index & 31)))) {
+        font_glyph_fill(&font_glyph_cache[index], c);
+        font_glyph_cached[index >> 5] |= 1u << (index & 31);
+    }
+    *glyph = font_glyph_cache[index];
+}
+
+STATIC void microbit_image_set_from_char(greyscale_t *img, char c) {
+    font_glyph_t glyph;
+    get_font_glyph(c, &glyph);
+    // Each row is 5 nibbles, so stream the rows out into bytes.
+    uint8_t *data = img->byte_data;
+    uint32_t bits = 0;
+    int num_bits = 0;
+    for (int y = 0; y < MICROBIT_DISPLAY_HEIGHT; ++y) {
+        bits |= font_row_nibbles[glyph.rows[y]] << num_bits;
+        for (num_bits += 20; num_bits >= 8; num_bits -= 8) {
+            *data++ = bits;
+            bits >>= 8;
         }
     }
+    *data = bits;
 }
 
 microbit_image_obj_t *microbit_image_for_char(char c) {
@@ -450,17 +537,25 @@ microbit_image_obj_t *microbit_image_for_char(char c) {
     return (microbit_image_obj_t *)result;
 }
 
+// Get the packed greyscale form of an image, converting a 5x5 monochrome image.
+STATIC greyscale_t *image_as_greyscale(microbit_image_obj_t *img) {
+    if (img->base.five) {
+        return image_copy(img);
+    }
+    return &img->greyscale;
+}
+
 microbit_image_obj_t *microbit_image_dim(microbit_image_obj_t *lhs, mp_float_t fval) {
     if (fval < 0) {
         mp_raise_ValueError(MP_ERROR_TEXT("brightness multiplier must not be negative"));
     }
-    greyscale_t *result = greyscale_new(image_width(lhs), image_height(lhs));
-    for (int x = 0; x < image_width(lhs); ++x) {
-        for (int y = 0; y < image_width(lhs); ++y) {
-            int val = MIN((int)image_get_pixel(lhs, x, y) * fval + 0.5, MICROBIT_DISPLAY_MAX_BRIGHTNESS);
-            greyscale_set_pixel(result, x, y, val);
-        }
+    // There are only 10 brightness levels, so scale each once and map the image through them.
+    uint8_t lut[16];
+    for (int val = 0; val < 16; ++val) {
+        lut[val] = MIN(MIN(val, MICROBIT_DISPLAY_MAX_BRIGHTNESS) * fval + 0.5, MICROBIT_DISPLAY_MAX_BRIGHTNESS);
     }
+    greyscale_t *result = greyscale_new(image_width(lhs), image_height(lhs));
+    greyscale_map(result, image_as_greyscale(lhs), lut);
     return (microbit_image_obj_t *)result;
 }
 
@@ -471,19 +566,7 @@ STATIC microbit_image_obj_t *microbit_image_sum(microbit_image_obj_t *lhs, micro
         mp_raise_ValueError(MP_ERROR_TEXT("images must be the same size"));
     }
     greyscale_t *result = greyscale_new(w, h);
-    for (int x = 0; x < w; ++x) {
-        for (int y = 0; y < h; ++y) {
-            int val;
-            int lval = image_get_pixel(lhs, x, y);
-            int rval = image_get_pixel(rhs, x, y);
-            if (add) {
-                val = MIN(lval + rval, MICROBIT_DISPLAY_MAX_BRIGHTNESS);
-            } else {
-                val = MAX(0, lval - rval);
-            }
-            greyscale_set_pixel(result, x, y, val);
-        }
-    }
+    greyscale_sum(result, image_as_greyscale(lhs), image_as_greyscale(rhs), add);
     return (microbit_image_obj_t *)result;
 }
 
@@ -530,6 +613,9 @@ typedef struct _scrolling_string_t {
     bool repeat;
 } scrolling_string_t;
 
+// The whole string is rendered once into columns, one byte per display
+// column with bit y set if row y is lit, and each frame is a 5-column window
+// into it.
 typedef struct _scrolling_string_iterator_t {
     mp_obj_base_t base;
     mp_obj_t ref;
@@ -542,6 +628,9 @@ typedef struct _scrolling_string_iterator_t {
     bool monospace;
     bool repeat;
     char right;
+    uint8_t *columns;
+    mp_uint_t num_columns;
+    mp_uint_t window;
 } scrolling_string_iterator_t;
 
 extern const mp_obj_type_t microbit_scrolling_string_type;
@@ -558,26 +647,6 @@ mp_obj_t scrolling_string_image_iterable(const char* str, mp_uint_t len, mp_obj_
     return result;
 }
 
-STATIC int font_column_non_blank(const unsigned char *font_data, unsigned int col) {
-    for (int y = 0; y < MICROBIT_DISPLAY_HEIGHT; ++y) {
-        if (get_pixel_from_font_data(font_data, col, y)) {
-            return 1;
-        }
-    }
-    return 0;
-}
-
-/* Not strictly the rightmost non-blank column, but the rightmost in columns 2,3 or 4. */
-STATIC unsigned int rightmost_non_blank_column(const unsigned char *font_data) {
-    if (font_column_non_blank(font_data, 4)) {
-        return 4;
-    }
-    if (font_column_non_blank(font_data, 3)) {
-        return 3;
-    }
-    return 2;
-}
-
 static void restart(scrolling_string_iterator_t *iter) {
     iter->next_char = iter->start;
     iter->offset = 0;
@@ -586,7 +655,9 @@ static void restart(scrolling_string_iterator_t *iter) {
         if (iter->monospace) {
             iter->offset_limit = 5;
         } else {
-            iter->offset_limit = rightmost_non_blank_column(get_font_data_from_char(iter->right)) + 1;
+            font_glyph_t glyph;
+            get_font_glyph(iter->right, &glyph);
+            iter->offset_limit = glyph.width;
         }
     } else {
         iter->right = ' ';
@@ -594,6 +665,38 @@ static void restart(scrolling_string_iterator_t *iter) {
     }
 }
 
+// Produce the next column of the scrolling text, or -1 at the end of the string.
+STATIC int scrolling_string_next_column(scrolling_string_iterator_t *iter) {
+    if (iter->next_char == iter->end && iter->offset == 5) {
+        return -1;
+    }
+    int column = 0;
+    font_glyph_t glyph;
+    if (iter->offset < iter->offset_limit) {
+        get_font_glyph(iter->right, &glyph);
+        column = glyph.columns[iter->offset];
+    } else if (iter->offset == iter->offset_limit) {
+        ++iter->next_char;
+        if (iter->next_char == iter->end) {
+            iter->right = ' ';
+            iter->offset_limit = 5;
+            iter->offset = 0;
+        } else {
+            iter->right = *iter->next_char;
+            if (iter->monospace) {
+                iter->offset = -1;
+                iter->offset_limit = 5;
+            } else {
+                get_font_glyph(iter->right, &glyph);
+                iter->offset = -glyph.lead;
+                iter->offset_limit = glyph.width;
+            }
+        }
+    }
+    ++iter->offset;
+    return column;
+}
+
 STATIC mp_obj_t get_microbit_scrolling_string_iter(mp_obj_t o_in, mp_obj_iter_buf_t *iter_buf) {
     (void)iter_buf; // not big enough to hold scrolling_string_iterator_t
     scrolling_string_t *str = (scrolling_string_t *)o_in;
@@ -605,54 +708,44 @@ STATIC mp_obj_t get_microbit_scrolling_string_iter(mp_obj_t o_in, mp_obj_iter_bu
     result->monospace = str->monospace;
     result->end = result->start + str->len;
     result->repeat = str->repeat;
+
+    // Render the text into columns, after 4 blank ones so it scrolls in from the right.
+    // This is done here rather than per frame because frames are produced in an interrupt.
+    mp_uint_t n = 0;
+    restart(result);
+    while (scrolling_string_next_column(result) >= 0) {
+        ++n;
+    }
+    result->num_columns = MICROBIT_DISPLAY_WIDTH - 1 + n;
+    result->columns = m_new0(uint8_t, result->num_columns);
     restart(result);
+    for (uint8_t *col = result->columns + MICROBIT_DISPLAY_WIDTH - 1; n--; ++col) {
+        *col = scrolling_string_next_column(result);
+    }
+    result->window = 0;
     return result;
 }
 
 STATIC mp_obj_t microbit_scrolling_string_iter_next(mp_obj_t o_in) {
     scrolling_string_iterator_t *iter = (scrolling_string_iterator_t *)o_in;
-    if (iter->next_char == iter->end && iter->offset == 5) {
+    if (iter->window + MICROBIT_DISPLAY_WIDTH > iter->num_columns) {
         if (iter->repeat) {
-            restart(iter);
-            greyscale_clear(iter->img);
+            iter->window = 0;
         } else {
             return MP_OBJ_STOP_ITERATION;
         }
     }
-    for (int x = 0; x < 4; x++) {
-        for (int y = 0; y < MICROBIT_DISPLAY_HEIGHT; y++) {
-            greyscale_set_pixel(iter->img, x, y, greyscale_get_pixel(iter->img, x+1, y));
-        }
-    }
-    for (int y = 0; y < MICROBIT_DISPLAY_HEIGHT; y++) {
-        greyscale_set_pixel(iter->img, 4, y, 0);
-    }
-    const unsigned char *font_data;
-    if (iter->offset < iter->offset_limit) {
-        font_data = get_font_data_from_char(iter->right);
-        for (int y = 0; y < MICROBIT_DISPLAY_HEIGHT; ++y) {
-            int pix = get_pixel_from_font_data(font_data, iter->offset, y)*MICROBIT_DISPLAY_MAX_BRIGHTNESS;
-            greyscale_set_pixel(iter->img, 4, y, pix);
-        }
-    } else if (iter->offset == iter->offset_limit) {
-        ++iter->next_char;
-        if (iter->next_char == iter->end) {
-            iter->right = ' ';
-            iter->offset_limit = 5;
-            iter->offset = 0;
-        } else {
-            iter->right = *iter->next_char;
-            font_data = get_font_data_from_char(iter->right);
-            if (iter->monospace) {
-                iter->offset = -1;
-                iter->offset_limit = 5;
-            } else {
-                iter->offset = -font_column_non_blank(font_data, 0);
-                iter->offset_limit = rightmost_non_blank_column(font_data)+1;
+    const uint8_t *columns = iter->columns + iter->window;
+    uint8_t *data = iter->img->byte_data;
+    memset(data, 0, (MICROBIT_DISPLAY_WIDTH * MICROBIT_DISPLAY_HEIGHT + 1) >> 1);
+    for (unsigned int y = 0, index = 0; y < MICROBIT_DISPLAY_HEIGHT; ++y) {
+        for (unsigned int x = 0; x < MICROBIT_DISPLAY_WIDTH; ++x, ++index) {
+            if (columns[x] & (1 << y)) {
+                data[index >> 1] |= MICROBIT_DISPLAY_MAX_BRIGHTNESS << ((index << 2) & 4);
             }
         }
     }
-    ++iter->offset;
+    ++iter->window;
     return iter->img;
 }
 
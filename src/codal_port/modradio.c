@@ -30,10 +30,44 @@
 #include "py/runtime.h"
 #include "py/mphal.h"
 #include "py/smallint.h"
+#include "py/binary.h"
 #include "drv_radio.h"
 
 STATIC microbit_radio_config_t radio_config;
 
+// Messages sent with send_large() are split into fragments, each sent as one
+// packet with this header:
+//  marker - byte, RADIO_FRAGMENT_MARKER
+//  tag    - 4 bytes, little endian, random number identifying the sender
+//  seq    - 2 bytes, little endian, message sequence number of the sender
+//  total  - 2 bytes, little endian, length of the whole message
+//  index  - 2 bytes, little endian, index of this fragment
+//  chunk  - byte, length of every fragment but the last
+// The fragment's data is at offset index * chunk of the message.
+#define RADIO_FRAGMENT_MARKER (0x02)
+#define RADIO_FRAGMENT_HEADER_LEN (12)
+
+#define RADIO_REASSEMBLY_MAX_MESSAGES (4)
+#define RADIO_REASSEMBLY_DEFAULT_BUDGET (4096)
+#define RADIO_REASSEMBLY_DEFAULT_TIMEOUT_MS (1000)
+
+// A message being reassembled by receive_large().  The table of these is held
+// by a root pointer, so the GC can see the message buffers.  The bitmap of
+// fragments received is kept in the message buffer, after the message.
+typedef struct _radio_large_msg_t {
+    vstr_t vstr; // the message, vstr.buf is NULL if this entry is free
+    uint32_t last_ms; // time the last fragment arrived
+    uint32_t tag;
+    uint16_t seq;
+    uint16_t num_received;
+    uint8_t chunk;
+} radio_large_msg_t;
+
+STATIC uint32_t radio_large_tag;
+STATIC uint16_t radio_large_seq;
+STATIC size_t radio_reassembly_budget;
+STATIC mp_int_t radio_reassembly_timeout_ms;
+
 STATIC mp_obj_t mod_radio_reset(void);
 
 STATIC void ensure_enabled(void) {
@@ -57,6 +91,11 @@ STATIC mp_obj_t mod_radio_reset(void) {
     radio_config.base0 = MICROBIT_RADIO_DEFAULT_BASE0;
     radio_config.prefix0 = MICROBIT_RADIO_DEFAULT_PREFIX0;
     radio_config.data_rate = MICROBIT_RADIO_DEFAULT_DATA_RATE;
+    MP_STATE_PORT(radio_receive_callback) = MP_OBJ_NULL;
+    microbit_radio_set_filter(NULL, 0, 0);
+    MP_STATE_PORT(radio_large_msgs) = NULL;
+    radio_reassembly_budget = RADIO_REASSEMBLY_DEFAULT_BUDGET;
+    radio_reassembly_timeout_ms = RADIO_REASSEMBLY_DEFAULT_TIMEOUT_MS;
     return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_0(mod_radio_reset_obj, mod_radio_reset);
@@ -70,6 +109,8 @@ STATIC mp_obj_t mod_radio_config(size_t n_args, const mp_obj_t *pos_args, mp_map
 
     // make a copy of the radio state so we don't change anything if there are value errors
     microbit_radio_config_t new_config = radio_config;
+    size_t new_reassembly_budget = radio_reassembly_budget;
+    mp_int_t new_reassembly_timeout_ms = radio_reassembly_timeout_ms;
 
     qstr arg_name = MP_QSTR_;
     for (size_t i = 0; i < kw_args->alloc; ++i) {
@@ -127,6 +168,20 @@ STATIC mp_obj_t mod_radio_config(size_t n_args, const mp_obj_t *pos_args, mp_map
                     new_config.prefix0 = value;
                     break;
 
+                case MP_QSTR_reassembly:
+                    if (!(0 <= value && value <= 0x3fffffff)) {
+                        goto value_error;
+                    }
+                    new_reassembly_budget = value;
+                    break;
+
+                case MP_QSTR_reassembly_timeout:
+                    if (!(1 <= value && value <= 0x3fffffff)) {
+                        goto value_error;
+                    }
+                    new_reassembly_timeout_ms = value;
+                    break;
+
                 default:
                     nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("unknown argument '%q'"), arg_name));
                     break;
@@ -134,6 +189,9 @@ STATIC mp_obj_t mod_radio_config(size_t n_args, const mp_obj_t *pos_args, mp_map
         }
     }
 
+    radio_reassembly_budget = new_reassembly_budget;
+    radio_reassembly_timeout_ms = new_reassembly_timeout_ms;
+
     // reconfigure the radio with the new state
 
     if (MP_STATE_PORT(radio_buf) == NULL) {
@@ -172,14 +230,22 @@ STATIC mp_obj_t mod_radio_off(void) {
 }
 MP_DEFINE_CONST_FUN_OBJ_0(mod_radio_off_obj, mod_radio_off);
 
-STATIC mp_obj_t mod_radio_send_bytes(mp_obj_t buf_in) {
+// Arguments for send() and send_bytes(): the message, and whether to wait for it to be sent.
+STATIC const mp_arg_t mod_radio_send_allowed_args[] = {
+    { MP_QSTR_message, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+    { MP_QSTR_wait, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = true} },
+};
+
+STATIC mp_obj_t mod_radio_send_bytes(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t args[MP_ARRAY_SIZE(mod_radio_send_allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(mod_radio_send_allowed_args), mod_radio_send_allowed_args, args);
     mp_buffer_info_t bufinfo;
-    mp_get_buffer_raise(buf_in, &bufinfo, MP_BUFFER_READ);
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_READ);
     ensure_enabled();
-    microbit_radio_send(bufinfo.buf, bufinfo.len, NULL, 0);
+    microbit_radio_send(bufinfo.buf, bufinfo.len, NULL, 0, args[1].u_bool);
     return mp_const_none;
 }
-MP_DEFINE_CONST_FUN_OBJ_1(mod_radio_send_bytes_obj, mod_radio_send_bytes);
+MP_DEFINE_CONST_FUN_OBJ_KW(mod_radio_send_bytes_obj, 1, mod_radio_send_bytes);
 
 STATIC mp_obj_t mod_radio_receive_bytes(void) {
     ensure_enabled();
@@ -194,14 +260,21 @@ STATIC mp_obj_t mod_radio_receive_bytes(void) {
 }
 MP_DEFINE_CONST_FUN_OBJ_0(mod_radio_receive_bytes_obj, mod_radio_receive_bytes);
 
-STATIC mp_obj_t mod_radio_send(mp_obj_t buf_in) {
+STATIC mp_obj_t mod_radio_send(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t args[MP_ARRAY_SIZE(mod_radio_send_allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(mod_radio_send_allowed_args), mod_radio_send_allowed_args, args);
     mp_uint_t len;
-    const char *data = mp_obj_str_get_data(buf_in, &len);
+    const char *data = mp_obj_str_get_data(args[0].u_obj, &len);
     ensure_enabled();
-    microbit_radio_send("\x01\x00\x01", 3, data, len);
+    microbit_radio_send("\x01\x00\x01", 3, data, len, args[1].u_bool);
     return mp_const_none;
 }
-MP_DEFINE_CONST_FUN_OBJ_1(mod_radio_send_obj, mod_radio_send);
+MP_DEFINE_CONST_FUN_OBJ_KW(mod_radio_send_obj, 1, mod_radio_send);
+
+STATIC mp_obj_t mod_radio_tx_pending(void) {
+    return MP_OBJ_NEW_SMALL_INT(microbit_radio_tx_pending());
+}
+MP_DEFINE_CONST_FUN_OBJ_0(mod_radio_tx_pending_obj, mod_radio_tx_pending);
 
 STATIC mp_obj_t mod_radio_receive(void) {
     ensure_enabled();
@@ -237,6 +310,15 @@ STATIC mp_obj_t mod_radio_receive_bytes_into(mp_obj_t buf_in) {
 }
 MP_DEFINE_CONST_FUN_OBJ_1(mod_radio_receive_bytes_into_obj, mod_radio_receive_bytes_into);
 
+// Return the timestamp of a packet on the RX queue, in the range of ticks_us().
+STATIC mp_int_t radio_packet_timestamp(const uint8_t *buf, size_t len) {
+    uint32_t timestamp_us = buf[1 + len + 1]
+        | buf[1 + len + 2] << 8
+        | buf[1 + len + 3] << 16
+        | buf[1 + len + 4] << 24;
+    return timestamp_us & (MICROPY_PY_UTIME_TICKS_PERIOD - 1);
+}
+
 STATIC mp_obj_t mod_radio_receive_full(void) {
     ensure_enabled();
     const uint8_t *buf = microbit_radio_peek();
@@ -244,15 +326,10 @@ STATIC mp_obj_t mod_radio_receive_full(void) {
         return mp_const_none;
     } else {
         size_t len = buf[0];
-        int rssi = -buf[1 + len];
-        uint32_t timestamp_us = buf[1 + len + 1]
-            | buf[1 + len + 2] << 8
-            | buf[1 + len + 3] << 16
-            | buf[1 + len + 4] << 24;
         mp_obj_t tuple[3] = {
             mp_obj_new_bytes(buf + 1, len),
-            MP_OBJ_NEW_SMALL_INT(rssi),
-            MP_OBJ_NEW_SMALL_INT(timestamp_us & (MICROPY_PY_UTIME_TICKS_PERIOD - 1))
+            MP_OBJ_NEW_SMALL_INT(MICROBIT_RADIO_PACKET_RSSI(buf, len)),
+            MP_OBJ_NEW_SMALL_INT(radio_packet_timestamp(buf, len))
         };
         microbit_radio_pop();
         return mp_obj_new_tuple(3, tuple);
@@ -260,6 +337,297 @@ STATIC mp_obj_t mod_radio_receive_full(void) {
 }
 MP_DEFINE_CONST_FUN_OBJ_0(mod_radio_receive_full_obj, mod_radio_receive_full);
 
+// receive_into_many(buffer, offsets, max_packets=-1, *, details=None)
+//
+// Copy waiting packets one after the other into buffer, without allocating.
+// Packet i ends up in buffer[offsets[i]:offsets[i + 1]], so offsets needs one
+// more entry than the number of packets.  If details is given then the RSSI
+// and timestamp of packet i are written to details[2 * i] and details[2 * i + 1].
+// Stops when the queue is empty, max_packets have been copied, or the next
+// packet doesn't fit, and returns the number of packets copied.
+STATIC mp_obj_t mod_radio_receive_into_many(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_buffer, ARG_offsets, ARG_max_packets, ARG_details };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buffer, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_offsets, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_max_packets, MP_ARG_INT, {.u_int = -1} },
+        { MP_QSTR_details, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_buffer_info_t data;
+    mp_get_buffer_raise(args[ARG_buffer].u_obj, &data, MP_BUFFER_WRITE);
+    mp_buffer_info_t offsets;
+    mp_get_buffer_raise(args[ARG_offsets].u_obj, &offsets, MP_BUFFER_WRITE);
+    size_t max_packets = offsets.len / mp_binary_get_size('@', offsets.typecode, NULL);
+    if (max_packets == 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("offsets too small"));
+    }
+    max_packets -= 1;
+    if (args[ARG_max_packets].u_int >= 0) {
+        max_packets = MIN(max_packets, (size_t)args[ARG_max_packets].u_int);
+    }
+    mp_buffer_info_t details = { .buf = NULL };
+    if (args[ARG_details].u_obj != mp_const_none) {
+        mp_get_buffer_raise(args[ARG_details].u_obj, &details, MP_BUFFER_WRITE);
+        max_packets = MIN(max_packets, details.len / mp_binary_get_size('@', details.typecode, NULL) / 2);
+    }
+
+    ensure_enabled();
+    size_t n = 0;
+    size_t offset = 0;
+    mp_binary_set_val_array_from_int(offsets.typecode, offsets.buf, 0, 0);
+    while (n < max_packets) {
+        const uint8_t *buf = microbit_radio_peek();
+        if (buf == NULL) {
+            break;
+        }
+        size_t len = buf[0];
+        if (offset + len > data.len) {
+            break;
+        }
+        memcpy((uint8_t *)data.buf + offset, buf + 1, len);
+        if (details.buf != NULL) {
+            mp_binary_set_val_array_from_int(details.typecode, details.buf, 2 * n, MICROBIT_RADIO_PACKET_RSSI(buf, len));
+            mp_binary_set_val_array_from_int(details.typecode, details.buf, 2 * n + 1, radio_packet_timestamp(buf, len));
+        }
+        microbit_radio_pop();
+        offset += len;
+        ++n;
+        mp_binary_set_val_array_from_int(offsets.typecode, offsets.buf, n, offset);
+    }
+    return MP_OBJ_NEW_SMALL_INT(n);
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(mod_radio_receive_into_many_obj, 2, mod_radio_receive_into_many);
+
+// on_receive(callback, *, prefix=None, length=0)
+//
+// Call callback() from the scheduler when packets arrive; several packets that
+// arrive before it runs share one call.  Pass None to stop the calls.  If prefix
+// or length are given then only packets starting with prefix, or with exactly
+// that length, are put on the receive queue; the rest are dropped in the radio
+// interrupt.  This applies to all the receive functions, not just the callback.
+STATIC mp_obj_t mod_radio_on_receive(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_callback, ARG_prefix, ARG_length };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_callback, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_prefix, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_length, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_obj_t callback = args[ARG_callback].u_obj;
+    if (callback == mp_const_none) {
+        callback = MP_OBJ_NULL;
+    } else if (!mp_obj_is_callable(callback)) {
+        mp_raise_TypeError(MP_ERROR_TEXT("callback must be callable"));
+    }
+    mp_buffer_info_t prefix = { .buf = NULL, .len = 0 };
+    if (args[ARG_prefix].u_obj != mp_const_none) {
+        mp_get_buffer_raise(args[ARG_prefix].u_obj, &prefix, MP_BUFFER_READ);
+        if (prefix.len > MICROBIT_RADIO_FILTER_PREFIX_MAX) {
+            mp_raise_ValueError(MP_ERROR_TEXT("prefix too long"));
+        }
+    }
+    mp_int_t length = args[ARG_length].u_int;
+    if (length < 0 || length > 251) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, MP_ERROR_TEXT("value out of range for argument '%q'"), MP_QSTR_length));
+    }
+
+    microbit_radio_set_filter(prefix.buf, prefix.len, length);
+    MP_STATE_PORT(radio_receive_callback) = callback;
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(mod_radio_on_receive_obj, 1, mod_radio_on_receive);
+
+// send_large(message, *, wait=True)
+//
+// Send a message of up to 65535 bytes as a sequence of fragments.  The
+// fragments go out through the TX queue; wait applies to the last one.
+STATIC mp_obj_t mod_radio_send_large(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t args[MP_ARRAY_SIZE(mod_radio_send_allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(mod_radio_send_allowed_args), mod_radio_send_allowed_args, args);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_READ);
+    ensure_enabled();
+
+    if (radio_config.max_payload <= RADIO_FRAGMENT_HEADER_LEN) {
+        mp_raise_ValueError(MP_ERROR_TEXT("radio length too small"));
+    }
+    if (bufinfo.len > 0xffff) {
+        mp_raise_ValueError(MP_ERROR_TEXT("message too long"));
+    }
+    size_t chunk = radio_config.max_payload - RADIO_FRAGMENT_HEADER_LEN;
+    size_t num_fragments = MAX(1, (bufinfo.len + chunk - 1) / chunk);
+
+    if (radio_large_tag == 0) {
+        // Identify this device's messages, so senders that happen to use the
+        // same sequence numbers don't get mixed up by the receiver.
+        do {
+            radio_large_tag = rng_generate_random_word();
+        } while (radio_large_tag == 0);
+        radio_large_seq = radio_large_tag >> 16;
+    }
+    uint32_t tag = radio_large_tag;
+    uint16_t seq = radio_large_seq++;
+    uint8_t header[RADIO_FRAGMENT_HEADER_LEN] = {
+        RADIO_FRAGMENT_MARKER,
+        tag, tag >> 8, tag >> 16, tag >> 24,
+        seq, seq >> 8,
+        bufinfo.len, bufinfo.len >> 8,
+        0, 0,
+        chunk,
+    };
+    for (size_t i = 0; i < num_fragments; ++i) {
+        size_t offset = i * chunk;
+        header[9] = i;
+        header[10] = i >> 8;
+        bool last = i == num_fragments - 1;
+        microbit_radio_send(header, sizeof(header), (const uint8_t *)bufinfo.buf + offset,
+            MIN(chunk, bufinfo.len - offset), last && args[1].u_bool);
+    }
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(mod_radio_send_large_obj, 1, mod_radio_send_large);
+
+STATIC void radio_large_free(radio_large_msg_t *msg) {
+    if (msg->vstr.buf != NULL) {
+        vstr_clear(&msg->vstr);
+        msg->vstr.buf = NULL;
+    }
+}
+
+// Size of a reassembly buffer: the message followed by the bitmap of fragments received.
+STATIC size_t radio_large_alloc_size(size_t total, size_t num_fragments) {
+    return total + (num_fragments + 7) / 8;
+}
+
+// Add a fragment to the reassembly table, and return the message if it's now complete.
+STATIC mp_obj_t radio_large_add_fragment(const uint8_t *pkt, size_t len) {
+    uint32_t tag = pkt[1] | pkt[2] << 8 | pkt[3] << 16 | (uint32_t)pkt[4] << 24;
+    uint16_t seq = pkt[5] | pkt[6] << 8;
+    size_t total = pkt[7] | pkt[8] << 8;
+    size_t index = pkt[9] | pkt[10] << 8;
+    size_t chunk = pkt[11];
+    if (chunk == 0) {
+        return MP_OBJ_NULL;
+    }
+    size_t num_fragments = MAX(1, (total + chunk - 1) / chunk);
+    size_t offset = index * chunk;
+    size_t size = radio_large_alloc_size(total, num_fragments);
+    len -= RADIO_FRAGMENT_HEADER_LEN;
+    if (index >= num_fragments || len != MIN(chunk, total - offset) || size > radio_reassembly_budget) {
+        // corrupt, or can never fit
+        return MP_OBJ_NULL;
+    }
+
+    radio_large_msg_t *msgs = MP_STATE_PORT(radio_large_msgs);
+    if (msgs == NULL) {
+        msgs = m_new0(radio_large_msg_t, RADIO_REASSEMBLY_MAX_MESSAGES);
+        MP_STATE_PORT(radio_large_msgs) = msgs;
+    }
+
+    // Find the message this fragment belongs to, expiring stale messages on the way.
+    uint32_t now = mp_hal_ticks_ms();
+    radio_large_msg_t *msg = NULL;
+    size_t used = 0;
+    for (size_t i = 0; i < RADIO_REASSEMBLY_MAX_MESSAGES; ++i) {
+        radio_large_msg_t *m = &msgs[i];
+        if (m->vstr.buf == NULL) {
+            continue;
+        }
+        if ((mp_int_t)(now - m->last_ms) > radio_reassembly_timeout_ms) {
+            radio_large_free(m);
+        } else if (m->tag == tag && m->seq == seq && m->vstr.len == total && m->chunk == chunk) {
+            msg = m;
+        } else {
+            used += m->vstr.alloc;
+        }
+    }
+
+    if (msg == NULL) {
+        // Start a new message, evicting the least recently updated ones to stay in budget.
+        for (;;) {
+            radio_large_msg_t *oldest = NULL;
+            for (size_t i = 0; i < RADIO_REASSEMBLY_MAX_MESSAGES; ++i) {
+                radio_large_msg_t *m = &msgs[i];
+                if (m->vstr.buf == NULL) {
+                    if (msg == NULL) {
+                        msg = m;
+                    }
+                } else if (oldest == NULL || (mp_int_t)(m->last_ms - oldest->last_ms) < 0) {
+                    oldest = m;
+                }
+            }
+            if (msg != NULL && used + size <= radio_reassembly_budget) {
+                break;
+            }
+            used -= oldest->vstr.alloc;
+            radio_large_free(oldest);
+            msg = NULL;
+        }
+        vstr_init(&msg->vstr, size);
+        msg->vstr.len = total;
+        memset(msg->vstr.buf + total, 0, size - total);
+        msg->tag = tag;
+        msg->seq = seq;
+        msg->chunk = chunk;
+        msg->num_received = 0;
+    }
+
+    msg->last_ms = now;
+    uint8_t *received = (uint8_t *)msg->vstr.buf + total;
+    if (!(received[index >> 3] & (1 << (index & 7)))) {
+        received[index >> 3] |= 1 << (index & 7);
+        msg->num_received += 1;
+        memcpy(msg->vstr.buf + offset, pkt + RADIO_FRAGMENT_HEADER_LEN, len);
+    }
+    if (msg->num_received < num_fragments) {
+        return MP_OBJ_NULL;
+    }
+
+    // The message is complete, hand its buffer over to a bytes object.
+    mp_obj_t ret = mp_obj_new_str_from_vstr(&mp_type_bytes, &msg->vstr);
+    msg->vstr.buf = NULL;
+    return ret;
+}
+
+// receive_large()
+//
+// Reassemble fragments from the front of the RX queue, and return the first
+// message that completes, or None.  Stops at a packet that isn't a fragment,
+// leaving it for the other receive functions.
+STATIC mp_obj_t mod_radio_receive_large(void) {
+    ensure_enabled();
+    for (;;) {
+        const uint8_t *buf = microbit_radio_peek();
+        if (buf == NULL) {
+            return mp_const_none;
+        }
+        size_t len = buf[0];
+        if (len < RADIO_FRAGMENT_HEADER_LEN || buf[1] != RADIO_FRAGMENT_MARKER) {
+            return mp_const_none;
+        }
+        mp_obj_t ret;
+        nlr_buf_t nlr;
+        if (nlr_push(&nlr) == 0) {
+            ret = radio_large_add_fragment(buf + 1, len);
+            nlr_pop();
+        } else {
+            // Don't leave the fragment on the queue if the message couldn't be allocated.
+            microbit_radio_pop();
+            nlr_jump(nlr.ret_val);
+        }
+        microbit_radio_pop();
+        if (ret != MP_OBJ_NULL) {
+            return ret;
+        }
+    }
+}
+MP_DEFINE_CONST_FUN_OBJ_0(mod_radio_receive_large_obj, mod_radio_receive_large);
+
 STATIC const mp_map_elem_t radio_module_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR___name__), MP_OBJ_NEW_QSTR(MP_QSTR_radio) },
     { MP_OBJ_NEW_QSTR(MP_QSTR___init__), (mp_obj_t)&mod_radio___init___obj },
@@ -271,9 +639,14 @@ STATIC const mp_map_elem_t radio_module_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_send_bytes), (mp_obj_t)&mod_radio_send_bytes_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_receive_bytes), (mp_obj_t)&mod_radio_receive_bytes_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_send), (mp_obj_t)&mod_radio_send_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_tx_pending), (mp_obj_t)&mod_radio_tx_pending_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_receive), (mp_obj_t)&mod_radio_receive_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_receive_bytes_into), (mp_obj_t)&mod_radio_receive_bytes_into_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_receive_full), (mp_obj_t)&mod_radio_receive_full_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_receive_into_many), (mp_obj_t)&mod_radio_receive_into_many_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_on_receive), (mp_obj_t)&mod_radio_on_receive_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_send_large), (mp_obj_t)&mod_radio_send_large_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_receive_large), (mp_obj_t)&mod_radio_receive_large_obj },
 
     // A rate of 250Kbit is physically supported by the nRF52 but it is deprecated,
     // so don't provide the constant to the Python user.  They can still select this
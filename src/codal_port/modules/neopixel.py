@@ -7,10 +7,20 @@ from microbit import ws2812_write
 class NeoPixel:
     ORDER = (1, 0, 2, 3)
 
-    def __init__(self, pin, n, bpp=3):
+    def __init__(self, pin, n, bpp=None, *, order=None):
+        if order is None:
+            order = "GRBW"[: bpp or 3]
+        if bpp is None:
+            bpp = len(order)
+        if bpp not in (3, 4) or len(order) != bpp:
+            raise ValueError("invalid bpp")
+        if order not in ("GRB", "RGB", "GRBW", "RGBW", "WRGB"):
+            raise ValueError("invalid order")
         self.pin = pin
         self.n = n
         self.bpp = bpp
+        self.order = order
+        self.ORDER = tuple(order.index(c) for c in "RGBW"[:bpp])
         self.buf = bytearray(n * bpp)
 
     def __setitem__(self, index, val):
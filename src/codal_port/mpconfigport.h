@@ -160,10 +160,13 @@ extern const struct _mp_obj_module_t utime_module;
     const char *readline_hist[8]; \
     void *display_data; \
     uint8_t *radio_buf; \
+    mp_obj_t radio_receive_callback; \
+    struct _radio_large_msg_t *radio_large_msgs; \
     void *audio_source; \
     void *speech_data; \
     struct _music_data_t *music_data; \
     struct _microbit_soft_timer_entry_t *soft_timer_heap; \
+    uint8_t *neopixel_tx_buf; \
 
 // These functions allow nested calls.
 extern void target_disable_irq(void);
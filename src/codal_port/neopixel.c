@@ -2,745 +2,1392 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <string.h>
-#include <assert.h>
+#include <math.h>
 
 #include "py/mphal.h"
 #include "py/obj.h"
 #include "py/objarray.h"
-#include "py/objtuple.h"
-#include "py/objtype.h"
 #include "py/runtime.h"
 
+#include "drv_display.h"
+#include "drv_image.h"
+#include "drv_softtimer.h"
 #include "modneopixel.h"
+#include "neopixelhal.h"
 
-#if MICROPY_DEBUG_VERBOSE // print debugging info
-#define DEBUG_PRINT (1)
-#define DEBUG_printf DEBUG_printf
-#else // don't print debugging info
-#define DEBUG_PRINT (0)
-#define DEBUG_printf(...) (void)0
-#endif
-
-#define ENABLE_SPECIAL_ACCESSORS \
-    (MICROPY_PY_DESCRIPTORS || MICROPY_PY_DELATTR_SETATTR || MICROPY_PY_BUILTINS_PROPERTY)
-
+// Wire position of each channel for the default GRB(W) order.
 #define COLOR_INDEX_RED (1)
 #define COLOR_INDEX_GREEN (0)
 #define COLOR_INDEX_BLUE (2)
 #define COLOR_INDEX_WHITE (3)
-#define COLOR_INDEX_MAP (COLOR_INDEX_WHITE << 12 | COLOR_INDEX_BLUE << 8 | COLOR_INDEX_GREEN << 4 | COLOR_INDEX_RED)
 
-//assert function for neopixel
-void assert_neopixel(mp_obj_t self_in) {
-    if (mp_obj_get_type(self_in) != &mod_NeoPixel_type) {
-        mp_raise_TypeError(MP_ERROR_TEXT("Expected a neopixel object"));
+// Pack the wire position of each of the R, G, B and W channels into a nibble map.
+#define COLOR_INDEX_MAP(r, g, b, w) ((w) << 12 | (b) << 8 | (g) << 4 | (r))
+
+#define NEOPIXEL_EFFECT_RAINBOW (0)
+#define NEOPIXEL_EFFECT_CHASE (1)
+#define NEOPIXEL_EFFECT_COMET (2)
+#define NEOPIXEL_EFFECT_TWINKLE (3)
+#define NEOPIXEL_EFFECT_FADE (4)
+
+#define NEOPIXEL_ANIM_MAX_COLORS (4)
+
+#define NEOPIXEL_WRITE_ALL_MAX_STRIPS MICROBIT_HAL_WS2812_MULTI_MAX
+
+// Corner of a panel where the first pixel is.
+#define NEOPIXEL_ORIGIN_TOP_LEFT (0)
+#define NEOPIXEL_ORIGIN_TOP_RIGHT (1)
+#define NEOPIXEL_ORIGIN_BOTTOM_LEFT (2)
+#define NEOPIXEL_ORIGIN_BOTTOM_RIGHT (3)
+
+// Channel order of a strip.  store/load convert between a colour in RGB(W)
+// order and a pixel in wire order, and are specialised for each order so that
+// indexing does no per-channel decoding.
+typedef struct _neopixel_format_t {
+    qstr name;
+    uint8_t bpp;
+    uint16_t map;
+    // Wire positions of red, green, blue and white, as returned by ORDER.
+    const mp_obj_tuple_t *order_tuple;
+    void (*store)(uint8_t *pixel, const uint8_t *color);
+    void (*load)(const uint8_t *pixel, uint8_t *color);
+} neopixel_format_t;
+
+// Fixed-layout NeoPixel object.  All fields needed by the hot paths (indexing,
+// write, clear) are stored directly so they can be accessed without any dict
+// lookups.  Python subclasses get this as their native sub-object.
+typedef struct _neopixel_obj_t {
+    mp_obj_base_t base;
+    mp_obj_t pin_obj;
+    uint8_t pin;
+    uint8_t bpp;
+    // Wire position of each channel, as packed by COLOR_INDEX_MAP.
+    uint16_t order;
+    const neopixel_format_t *format;
+    // Set once the buf attribute has been handed out to Python, after which
+    // changes can no longer be tracked and every write sends the whole strip.
+    bool buf_exported;
+    size_t num_pixels;
+    mp_obj_array_t *buf;
+    // Pixels as sent to the strip, allocated on demand.  Used as the snapshot
+    // for non-blocking output and when brightness/gamma are applied.
+    uint8_t *tx_buf;
+    // Output brightness and gamma curve (NULL for linear), combined into lut
+    // which is applied to every byte on write (NULL if it is the identity).
+    uint8_t brightness;
+    uint8_t *gamma;
+    uint8_t *lut;
+    // Background effect currently driving this strip, if any.
+    struct _neopixel_anim_t *anim;
+    // Identifies the strip to the neopixelhal simulator hooks.
+    int hal_id;
+    // Panel geometry, with layout mapping (x, y) to a pixel index at layout[y * width + x].
+    // layout is NULL if no geometry was given.
+    uint16_t width;
+    uint16_t height;
+    uint16_t *layout;
+    // Range of pixels modified since the last write, empty if start >= end.
+    size_t dirty_start;
+    size_t dirty_end;
+} neopixel_obj_t;
+
+static inline uint8_t *neopixel_pixels(neopixel_obj_t *self) {
+    return (uint8_t *)self->buf->items;
+}
+
+static inline size_t neopixel_buf_len(neopixel_obj_t *self) {
+    return self->num_pixels * self->bpp;
+}
+
+static inline void neopixel_mark_dirty(neopixel_obj_t *self, size_t start, size_t end) {
+    if (start < self->dirty_start) {
+        self->dirty_start = start;
+    }
+    if (end > self->dirty_end) {
+        self->dirty_end = end;
     }
 }
 
-//copied and modified from py/objtype.c
-struct class_lookup_data {
-    mp_obj_instance_t *obj;
-    qstr attr;
-    size_t meth_offset;
-    mp_obj_t *dest;
-    bool is_type;
+STATIC void neopixel_store_rgb_order(uint8_t *pixel, const uint8_t *color) {
+    pixel[0] = color[0];
+    pixel[1] = color[1];
+    pixel[2] = color[2];
+}
+
+STATIC void neopixel_store_grb_order(uint8_t *pixel, const uint8_t *color) {
+    pixel[0] = color[1];
+    pixel[1] = color[0];
+    pixel[2] = color[2];
+}
+
+STATIC void neopixel_store_rgbw_order(uint8_t *pixel, const uint8_t *color) {
+    pixel[0] = color[0];
+    pixel[1] = color[1];
+    pixel[2] = color[2];
+    pixel[3] = color[3];
+}
+
+STATIC void neopixel_store_grbw_order(uint8_t *pixel, const uint8_t *color) {
+    pixel[0] = color[1];
+    pixel[1] = color[0];
+    pixel[2] = color[2];
+    pixel[3] = color[3];
+}
+
+STATIC void neopixel_store_wrgb_order(uint8_t *pixel, const uint8_t *color) {
+    pixel[0] = color[3];
+    pixel[1] = color[0];
+    pixel[2] = color[1];
+    pixel[3] = color[2];
+}
+
+STATIC void neopixel_load_rgb_order(const uint8_t *pixel, uint8_t *color) {
+    color[0] = pixel[0];
+    color[1] = pixel[1];
+    color[2] = pixel[2];
+}
+
+STATIC void neopixel_load_grb_order(const uint8_t *pixel, uint8_t *color) {
+    color[0] = pixel[1];
+    color[1] = pixel[0];
+    color[2] = pixel[2];
+}
+
+STATIC void neopixel_load_rgbw_order(const uint8_t *pixel, uint8_t *color) {
+    color[0] = pixel[0];
+    color[1] = pixel[1];
+    color[2] = pixel[2];
+    color[3] = pixel[3];
+}
+
+STATIC void neopixel_load_grbw_order(const uint8_t *pixel, uint8_t *color) {
+    color[0] = pixel[1];
+    color[1] = pixel[0];
+    color[2] = pixel[2];
+    color[3] = pixel[3];
+}
+
+STATIC void neopixel_load_wrgb_order(const uint8_t *pixel, uint8_t *color) {
+    color[0] = pixel[1];
+    color[1] = pixel[2];
+    color[2] = pixel[3];
+    color[3] = pixel[0];
+}
+
+// The class constant NeoPixel.ORDER gives the wire positions for the default GRB
+// order only.  On an instance, ORDER is served by mod_neopixel_attr from the
+// strip's own order=, but note that through a Python subclass the class constant
+// is found first.
+STATIC const mp_obj_tuple_t mod_neopixel_ORDER_obj = {
+    {&mp_type_tuple},
+    4,
+    {
+        MP_OBJ_NEW_SMALL_INT(COLOR_INDEX_RED),
+        MP_OBJ_NEW_SMALL_INT(COLOR_INDEX_GREEN),
+        MP_OBJ_NEW_SMALL_INT(COLOR_INDEX_BLUE),
+        MP_OBJ_NEW_SMALL_INT(COLOR_INDEX_WHITE)
+    }
 };
 
-STATIC void mp_obj_class_lookup(struct class_lookup_data *lookup, const mp_obj_type_t *type) {
-    assert(lookup->dest[0] == MP_OBJ_NULL);
-    assert(lookup->dest[1] == MP_OBJ_NULL);
-    for (;;) {
-        DEBUG_printf("mp_obj_class_lookup: Looking up %s in %s\n", qstr_str(lookup->attr), qstr_str(type->name));
-        // Optimize special method lookup for native types
-        // This avoids extra method_name => slot lookup. On the other hand,
-        // this should not be applied to class types, as will result in extra
-        // lookup either.
-        if (type->locals_dict != NULL) {
-            // search locals_dict (the set of methods/attributes)
-            assert(mp_obj_is_dict_or_ordereddict(MP_OBJ_FROM_PTR(type->locals_dict))); // MicroPython restriction, for now
-            mp_map_t *locals_map = &type->locals_dict->map;
-            mp_map_elem_t *elem = mp_map_lookup(locals_map, MP_OBJ_NEW_QSTR(lookup->attr), MP_MAP_LOOKUP);
-            if (elem != NULL) {
-                if (lookup->is_type) {
-                    // If we look up a class method, we need to return original type for which we
-                    // do a lookup, not a (base) type in which we found the class method.
-                    const mp_obj_type_t *org_type = (const mp_obj_type_t *)lookup->obj;
-                    mp_convert_member_lookup(MP_OBJ_NULL, org_type, elem->value, lookup->dest);
-                } else {
-                    mp_obj_instance_t *obj = lookup->obj;
-                    mp_obj_t obj_obj;
-                    obj_obj = MP_OBJ_FROM_PTR(obj);
-                    mp_convert_member_lookup(obj_obj, type, elem->value, lookup->dest);
-                }
-                #if DEBUG_PRINT
-                DEBUG_printf("mp_obj_class_lookup: Returning: ");
-                mp_obj_print_helper(MICROPY_DEBUG_PRINTER, lookup->dest[0], PRINT_REPR);
-                if (lookup->dest[1] != MP_OBJ_NULL) {
-                    // Don't try to repr() lookup->dest[1], as we can be called recursively
-                    DEBUG_printf(" <%s @%p>", mp_obj_get_type_str(lookup->dest[1]), MP_OBJ_TO_PTR(lookup->dest[1]));
-                }
-                DEBUG_printf("\n");
-                #endif
-                return;
-            }
-        }
+STATIC const mp_obj_tuple_t neopixel_order_rgb_obj = {
+    {&mp_type_tuple},
+    4,
+    {
+        MP_OBJ_NEW_SMALL_INT(0),
+        MP_OBJ_NEW_SMALL_INT(1),
+        MP_OBJ_NEW_SMALL_INT(2),
+        MP_OBJ_NEW_SMALL_INT(3)
+    }
+};
+
+STATIC const mp_obj_tuple_t neopixel_order_wrgb_obj = {
+    {&mp_type_tuple},
+    4,
+    {
+        MP_OBJ_NEW_SMALL_INT(1),
+        MP_OBJ_NEW_SMALL_INT(2),
+        MP_OBJ_NEW_SMALL_INT(3),
+        MP_OBJ_NEW_SMALL_INT(0)
+    }
+};
+
+// The first entry for each bpp is the default.
+STATIC const neopixel_format_t neopixel_formats[] = {
+    { MP_QSTR_GRB, 3, COLOR_INDEX_MAP(COLOR_INDEX_RED, COLOR_INDEX_GREEN, COLOR_INDEX_BLUE, COLOR_INDEX_WHITE), &mod_neopixel_ORDER_obj, neopixel_store_grb_order, neopixel_load_grb_order },
+    { MP_QSTR_RGB, 3, COLOR_INDEX_MAP(0, 1, 2, 3), &neopixel_order_rgb_obj, neopixel_store_rgb_order, neopixel_load_rgb_order },
+    { MP_QSTR_GRBW, 4, COLOR_INDEX_MAP(COLOR_INDEX_RED, COLOR_INDEX_GREEN, COLOR_INDEX_BLUE, COLOR_INDEX_WHITE), &mod_neopixel_ORDER_obj, neopixel_store_grbw_order, neopixel_load_grbw_order },
+    { MP_QSTR_RGBW, 4, COLOR_INDEX_MAP(0, 1, 2, 3), &neopixel_order_rgb_obj, neopixel_store_rgbw_order, neopixel_load_rgbw_order },
+    { MP_QSTR_WRGB, 4, COLOR_INDEX_MAP(1, 2, 3, 0), &neopixel_order_wrgb_obj, neopixel_store_wrgb_order, neopixel_load_wrgb_order },
+};
 
-        // Previous code block takes care about attributes defined in .locals_dict,
-        // but some attributes of native types may be handled using .load_attr method,
-        // so make sure we try to lookup those too.
-        if (lookup->obj != NULL && !lookup->is_type && mp_obj_is_native_type(type) && type != &mp_type_object /* object is not a real type */) {
-            mp_load_method_maybe(lookup->obj->subobj[0], lookup->attr, lookup->dest);
-            if (lookup->dest[0] != MP_OBJ_NULL) {
-                return;
+// Find the format for an order string, or the default one for bpp if order_in is None.
+STATIC const neopixel_format_t *neopixel_get_format(mp_obj_t order_in, mp_int_t bpp) {
+    for (size_t i = 0; i < MP_ARRAY_SIZE(neopixel_formats); ++i) {
+        const neopixel_format_t *format = &neopixel_formats[i];
+        if (order_in == mp_const_none) {
+            if (format->bpp == bpp) {
+                return format;
             }
+        } else if (strcmp(mp_obj_str_get_str(order_in), qstr_str(format->name)) == 0) {
+            return format;
         }
+    }
+    if (order_in == mp_const_none) {
+        mp_raise_ValueError(MP_ERROR_TEXT("invalid bpp"));
+    }
+    mp_raise_ValueError(MP_ERROR_TEXT("invalid order"));
+}
 
-        // attribute not found, keep searching base classes
-
-        if (type->parent == NULL) {
-            DEBUG_printf("mp_obj_class_lookup: No more parents\n");
-            return;
-        #if MICROPY_MULTIPLE_INHERITANCE
-        } else if (((mp_obj_base_t *)type->parent)->type == &mp_type_tuple) {
-            const mp_obj_tuple_t *parent_tuple = type->parent;
-            const mp_obj_t *item = parent_tuple->items;
-            const mp_obj_t *top = item + parent_tuple->len - 1;
-            for (; item < top; ++item) {
-                assert(mp_obj_is_type(*item, &mp_type_type));
-                mp_obj_type_t *bt = (mp_obj_type_t *)MP_OBJ_TO_PTR(*item);
-                if (bt == &mp_type_object) {
-                    // Not a "real" type
-                    continue;
-                }
-                mp_obj_class_lookup(lookup, bt);
-                if (lookup->dest[0] != MP_OBJ_NULL) {
-                    return;
-                }
-            }
+STATIC uint8_t neopixel_get_color_byte(mp_obj_t color_in) {
+    mp_int_t color = mp_obj_get_int(color_in);
+    if (color > 255) {
+        color = color % 255;
+    }
+    if (color < 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("invalid color"));
+    }
+    return color;
+}
 
-            // search last base (simple tail recursion elimination)
-            assert(mp_obj_is_type(*item, &mp_type_type));
-            type = (mp_obj_type_t *)MP_OBJ_TO_PTR(*item);
-        #endif
-        } else {
-            type = type->parent;
+// Store the channels of the given colour into a pixel in wire order.  If the
+// colour has fewer channels than the strip then the remaining ones are left as-is.
+STATIC void neopixel_parse_color(neopixel_obj_t *self, mp_obj_t color_in, uint8_t *pixel) {
+    size_t len;
+    mp_obj_t *rgb;
+    mp_obj_get_array(color_in, &len, &rgb);
+    if (len > self->bpp) {
+        mp_raise_ValueError(MP_ERROR_TEXT("invalid color"));
+    }
+    if (len == self->bpp) {
+        uint8_t color[4];
+        for (size_t i = 0; i < len; ++i) {
+            color[i] = neopixel_get_color_byte(rgb[i]);
         }
-        if (type == &mp_type_object) {
-            // Not a "real" type
-            return;
+        self->format->store(pixel, color);
+        return;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        pixel[(self->order >> (4 * i)) & 0xf] = neopixel_get_color_byte(rgb[i]);
+    }
+}
+
+STATIC void neopixel_set_pixel(neopixel_obj_t *self, size_t index, mp_obj_t color_in) {
+    neopixel_parse_color(self, color_in, neopixel_pixels(self) + index * self->bpp);
+    neopixel_mark_dirty(self, index, index + 1);
+}
+
+// Replicate a single pixel across len bytes of dest.  12 bytes is a whole number
+// of pixels for both 3 and 4 bpp, and a whole number of words, so the bulk of the
+// buffer is filled using aligned word stores of a precomputed 12-byte pattern.
+STATIC void neopixel_fill_pattern(uint8_t *dest, size_t len, const uint8_t *pixel, size_t bpp) {
+    size_t phase = 0;
+    while (len > 0 && ((uintptr_t)dest & 3) != 0) {
+        *dest++ = pixel[phase];
+        if (++phase == bpp) {
+            phase = 0;
         }
+        --len;
+    }
+
+    uint32_t pattern[3];
+    uint8_t *pattern_bytes = (uint8_t *)pattern;
+    for (size_t i = 0; i < sizeof(pattern); ++i) {
+        pattern_bytes[i] = pixel[(phase + i) % bpp];
+    }
+
+    uint32_t *dest_word = (uint32_t *)dest;
+    for (; len >= sizeof(pattern); len -= sizeof(pattern)) {
+        dest_word[0] = pattern[0];
+        dest_word[1] = pattern[1];
+        dest_word[2] = pattern[2];
+        dest_word += 3;
+    }
+
+    dest = (uint8_t *)dest_word;
+    for (size_t i = 0; i < len; ++i) {
+        dest[i] = pattern_bytes[i];
     }
 }
 
-STATIC void mp_obj_NeoPixel_load_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
-    // logic: look in instance members then class locals
-    assert_neopixel(self_in);
-    mp_obj_instance_t *self = MP_OBJ_TO_PTR(self_in);
+// Convert a Python start/end pixel index to a position within the strip,
+// following slice semantics for negative and out-of-range values.
+STATIC size_t neopixel_get_bound(neopixel_obj_t *self, mp_obj_t index_in) {
+    mp_int_t index = mp_obj_get_int(index_in);
+    if (index < 0) {
+        index += self->num_pixels;
+        if (index < 0) {
+            index = 0;
+        }
+    } else if ((size_t)index > self->num_pixels) {
+        index = self->num_pixels;
+    }
+    return index;
+}
 
-    // Note: This is fast-path'ed in the VM for the MP_BC_LOAD_ATTR operation.
-    mp_map_elem_t *elem = mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(attr), MP_MAP_LOOKUP);
-    if (elem != NULL) {
-        // object member, always treated as a value
-        dest[0] = elem->value;
+// Work out where each channel of a packed source pixel goes in the wire-order
+// pixel.  The source order is a string such as "RGB" or "WRGB"; if NULL then
+// the source is taken to be RGB (or RGBW for 4 bpp strips).
+STATIC void neopixel_get_channel_map(neopixel_obj_t *self, mp_obj_t order_in, uint8_t *map) {
+    static const char channels[] = "RGBW";
+    if (order_in == MP_OBJ_NULL) {
+        for (size_t i = 0; i < self->bpp; ++i) {
+            map[i] = (self->order >> (4 * i)) & 0xf;
+        }
         return;
     }
-    #if MICROPY_CPYTHON_COMPAT
-    if (attr == MP_QSTR___dict__) {
-        // Create a new dict with a copy of the instance's map items.
-        // This creates, unlike CPython, a read-only __dict__ that can't be modified.
-        mp_obj_dict_t dict;
-        dict.base.type = &mp_type_dict;
-        dict.map = self->members;
-        dest[0] = mp_obj_dict_copy(MP_OBJ_FROM_PTR(&dict));
-        mp_obj_dict_t *dest_dict = MP_OBJ_TO_PTR(dest[0]);
-        dest_dict->map.is_fixed = 1;
-        return;
+    size_t len;
+    const char *order = mp_obj_str_get_data(order_in, &len);
+    if (len != self->bpp) {
+        mp_raise_ValueError(MP_ERROR_TEXT("invalid order"));
     }
-    #endif
-    struct class_lookup_data lookup = {
-        .obj = self,
-        .attr = attr,
-        .meth_offset = 0,
-        .dest = dest,
-        .is_type = false,
-    };
-    mp_obj_class_lookup(&lookup, self->base.type);
-    mp_obj_t member = dest[0];
-    if (member != MP_OBJ_NULL) {
-        if (!(self->base.type->flags & MP_TYPE_FLAG_HAS_SPECIAL_ACCESSORS)) {
-            // Class doesn't have any special accessors to check so return straightaway
-            return;
-        }
-
-        #if MICROPY_PY_BUILTINS_PROPERTY
-        if (mp_obj_is_type(member, &mp_type_property)) {
-            // object member is a property; delegate the load to the property
-            // Note: This is an optimisation for code size and execution time.
-            // The proper way to do it is have the functionality just below
-            // in a __get__ method of the property object, and then it would
-            // be called by the descriptor code down below.  But that way
-            // requires overhead for the nested mp_call's and overhead for
-            // the code.
-            const mp_obj_t *proxy = mp_obj_property_get(member);
-            if (proxy[0] == mp_const_none) {
-                mp_raise_msg(&mp_type_AttributeError, MP_ERROR_TEXT("unreadable attribute"));
-            } else {
-                dest[0] = mp_call_function_n_kw(proxy[0], 1, 0, &self_in);
-            }
-            return;
-        }
-        #endif
-
-        #if MICROPY_PY_DESCRIPTORS
-        // found a class attribute; if it has a __get__ method then call it with the
-        // class instance and class as arguments and return the result
-        // Note that this is functionally correct but very slow: each load_attr
-        // requires an extra mp_load_method_maybe to check for the __get__.
-        mp_obj_t attr_get_method[4];
-        mp_load_method_maybe(member, MP_QSTR___get__, attr_get_method);
-        if (attr_get_method[0] != MP_OBJ_NULL) {
-            attr_get_method[2] = self_in;
-            attr_get_method[3] = MP_OBJ_FROM_PTR(mp_obj_get_type(self_in));
-            dest[0] = mp_call_method_n_kw(2, 0, attr_get_method);
-        }
-        #endif
-        return;
+    uint8_t seen = 0;
+    for (size_t i = 0; i < len; ++i) {
+        const char *c = order[i] == '\0' ? NULL : strchr(channels, order[i]);
+        size_t channel = c == NULL ? 4 : (size_t)(c - channels);
+        if (channel >= self->bpp || (seen & (1 << channel))) {
+            mp_raise_ValueError(MP_ERROR_TEXT("invalid order"));
+        }
+        seen |= 1 << channel;
+        map[i] = (self->order >> (4 * channel)) & 0xf;
     }
+}
 
-    // try __getattr__
-    if (attr != MP_QSTR___getattr__) {
-        #if MICROPY_PY_DELATTR_SETATTR
-        // If the requested attr is __setattr__/__delattr__ then don't delegate the lookup
-        // to __getattr__.  If we followed CPython's behaviour then __setattr__/__delattr__
-        // would have already been found in the "object" base class.
-        if (attr == MP_QSTR___setattr__ || attr == MP_QSTR___delattr__) {
-            return;
+// Copy packed pixels into the strip buffer, reordering the channels of each
+// pixel so that source byte i ends up at offset map[i] of the destination.
+STATIC void neopixel_load_pixels(uint8_t *dest, const uint8_t *src, size_t num_pixels, size_t bpp, const uint8_t *map) {
+    uint8_t m0 = map[0];
+    uint8_t m1 = map[1];
+    uint8_t m2 = map[2];
+    if (bpp == 3) {
+        for (; num_pixels > 0; --num_pixels) {
+            dest[m0] = src[0];
+            dest[m1] = src[1];
+            dest[m2] = src[2];
+            dest += 3;
+            src += 3;
         }
-        #endif
-
-        mp_obj_t dest2[3];
-        mp_load_method_maybe(self_in, MP_QSTR___getattr__, dest2);
-        if (dest2[0] != MP_OBJ_NULL) {
-            // __getattr__ exists, call it and return its result
-            dest2[2] = MP_OBJ_NEW_QSTR(attr);
-            dest[0] = mp_call_method_n_kw(1, 0, dest2);
-            return;
+    } else {
+        uint8_t m3 = map[3];
+        for (; num_pixels > 0; --num_pixels) {
+            dest[m0] = src[0];
+            dest[m1] = src[1];
+            dest[m2] = src[2];
+            dest[m3] = src[3];
+            dest += 4;
+            src += 4;
         }
     }
 }
 
-STATIC bool mp_obj_NeoPixel_store_attr(mp_obj_t self_in, qstr attr, mp_obj_t value) {
-	assert_neopixel(self_in);
-    mp_obj_instance_t *self = MP_OBJ_TO_PTR(self_in);
+// Load pixels from a bytes-like object in the given channel order, starting at
+// pixel index start.  The buffer must contain exactly num_pixels pixels.
+STATIC void neopixel_load_buffer(neopixel_obj_t *self, size_t start, size_t num_pixels, const mp_buffer_info_t *bufinfo, mp_obj_t order_in) {
+    if (bufinfo->len != num_pixels * self->bpp) {
+        mp_raise_ValueError(MP_ERROR_TEXT("buffer has wrong length"));
+    }
+    uint8_t map[4];
+    neopixel_get_channel_map(self, order_in, map);
+    neopixel_load_pixels(neopixel_pixels(self) + start * self->bpp, bufinfo->buf, num_pixels, self->bpp, map);
+    neopixel_mark_dirty(self, start, start + num_pixels);
+}
 
-    if (!(self->base.type->flags & MP_TYPE_FLAG_HAS_SPECIAL_ACCESSORS)) {
-        // Class doesn't have any special accessors so skip their checks
-        goto skip_special_accessors;
+STATIC void neopixel_set_slice(neopixel_obj_t *self, mp_obj_t index_in, mp_obj_t value) {
+    mp_bound_slice_t slice;
+    if (!mp_seq_get_fast_slice_indexes(self->num_pixels, index_in, &slice)) {
+        mp_raise_NotImplementedError(MP_ERROR_TEXT("only slices with step=1 (aka None) are supported"));
     }
+    size_t start = slice.start;
+    size_t num_pixels = slice.stop > slice.start ? slice.stop - slice.start : 0;
 
-    #if MICROPY_PY_BUILTINS_PROPERTY || MICROPY_PY_DESCRIPTORS
-    // With property and/or descriptors enabled we need to do a lookup
-    // first in the class dict for the attribute to see if the store should
-    // be delegated.
-    mp_obj_t member[2] = {MP_OBJ_NULL};
-    struct class_lookup_data lookup = {
-        .obj = self,
-        .attr = attr,
-        .meth_offset = 0,
-        .dest = member,
-        .is_type = false,
-    };
-    mp_obj_class_lookup(&lookup, self->base.type);
-
-    if (member[0] != MP_OBJ_NULL) {
-        #if MICROPY_PY_BUILTINS_PROPERTY
-        if (mp_obj_is_type(member[0], &mp_type_property)) {
-            // attribute exists and is a property; delegate the store/delete
-            // Note: This is an optimisation for code size and execution time.
-            // The proper way to do it is have the functionality just below in
-            // a __set__/__delete__ method of the property object, and then it
-            // would be called by the descriptor code down below.  But that way
-            // requires overhead for the nested mp_call's and overhead for
-            // the code.
-            const mp_obj_t *proxy = mp_obj_property_get(member[0]);
-            mp_obj_t dest[2] = {self_in, value};
-            if (value == MP_OBJ_NULL) {
-                // delete attribute
-                if (proxy[2] == mp_const_none) {
-                    // TODO better error message?
-                    return false;
-                } else {
-                    mp_call_function_n_kw(proxy[2], 1, 0, dest);
-                    return true;
-                }
-            } else {
-                // store attribute
-                if (proxy[1] == mp_const_none) {
-                    // TODO better error message?
-                    return false;
-                } else {
-                    mp_call_function_n_kw(proxy[1], 2, 0, dest);
-                    return true;
-                }
-            }
+    mp_buffer_info_t bufinfo;
+    if (mp_get_buffer(value, &bufinfo, MP_BUFFER_READ)) {
+        // Packed RGB(W) data.
+        neopixel_load_buffer(self, start, num_pixels, &bufinfo, MP_OBJ_NULL);
+        return;
+    }
+
+    // Iterable of colour tuples.
+    mp_obj_iter_buf_t iter_buf;
+    mp_obj_t iterable = mp_getiter(value, &iter_buf);
+    mp_obj_t item;
+    size_t i = 0;
+    while ((item = mp_iternext(iterable)) != MP_OBJ_STOP_ITERATION) {
+        if (i == num_pixels) {
+            mp_raise_ValueError(MP_ERROR_TEXT("too many colors"));
         }
-        #endif
-
-        #if MICROPY_PY_DESCRIPTORS
-        // found a class attribute; if it has a __set__/__delete__ method then
-        // call it with the class instance (and value) as arguments
-        if (value == MP_OBJ_NULL) {
-            // delete attribute
-            mp_obj_t attr_delete_method[3];
-            mp_load_method_maybe(member[0], MP_QSTR___delete__, attr_delete_method);
-            if (attr_delete_method[0] != MP_OBJ_NULL) {
-                attr_delete_method[2] = self_in;
-                mp_call_method_n_kw(1, 0, attr_delete_method);
-                return true;
-            }
-        } else {
-            // store attribute
-            mp_obj_t attr_set_method[4];
-            mp_load_method_maybe(member[0], MP_QSTR___set__, attr_set_method);
-            if (attr_set_method[0] != MP_OBJ_NULL) {
-                attr_set_method[2] = self_in;
-                attr_set_method[3] = value;
-                mp_call_method_n_kw(2, 0, attr_set_method);
-                return true;
-            }
+        neopixel_set_pixel(self, start + i, item);
+        ++i;
+    }
+    if (i != num_pixels) {
+        mp_raise_ValueError(MP_ERROR_TEXT("not enough colors"));
+    }
+}
+
+STATIC mp_obj_t neopixel_get_pixel(neopixel_obj_t *self, size_t index) {
+    uint8_t color[4];
+    self->format->load(neopixel_pixels(self) + index * self->bpp, color);
+    mp_obj_t rgb[4];
+    for (size_t i = 0; i < self->bpp; ++i) {
+        rgb[i] = MP_OBJ_NEW_SMALL_INT(color[i]);
+    }
+    return mp_obj_new_tuple(self->bpp, rgb);
+}
+
+// Wait for any non-blocking output to finish, so a new one can be started or
+// the pin can be driven directly.
+STATIC void neopixel_wait_tx(void) {
+    while (microbit_hal_pin_ws2812_busy()) {
+        mp_handle_pending(true);
+        microbit_hal_idle();
+    }
+}
+
+// Wait for the DMA driver to be idle and return with interrupts disabled, so a
+// background effect can't start a transfer from the soft timer before the
+// caller starts its own, or while the caller bit-bangs a blocking write with
+// the PWM refill interrupt held off.  The caller must end the atomic section.
+STATIC mp_uint_t neopixel_claim_tx(void) {
+    for (;;) {
+        neopixel_wait_tx();
+        mp_uint_t atomic_state = MICROPY_BEGIN_ATOMIC_SECTION();
+        if (!microbit_hal_pin_ws2812_busy()) {
+            return atomic_state;
         }
-        #endif
+        MICROPY_END_ATOMIC_SECTION(atomic_state);
     }
-    #endif
+}
 
-    #if MICROPY_PY_DELATTR_SETATTR
-    if (value == MP_OBJ_NULL) {
-        // delete attribute
-        // try __delattr__ first
-        mp_obj_t attr_delattr_method[3];
-        mp_load_method_maybe(self_in, MP_QSTR___delattr__, attr_delattr_method);
-        if (attr_delattr_method[0] != MP_OBJ_NULL) {
-            // __delattr__ exists, so call it
-            attr_delattr_method[2] = MP_OBJ_NEW_QSTR(attr);
-            mp_call_method_n_kw(1, 0, attr_delattr_method);
-            return true;
+// Copy the pixels into tx_buf, which must already be allocated, applying the
+// brightness/gamma table if there is one.
+STATIC void neopixel_render_tx(neopixel_obj_t *self) {
+    size_t len = neopixel_buf_len(self);
+    const uint8_t *pixels = neopixel_pixels(self);
+    if (self->lut != NULL) {
+        const uint8_t *lut = self->lut;
+        for (size_t i = 0; i < len; ++i) {
+            self->tx_buf[i] = lut[pixels[i]];
         }
     } else {
-        // store attribute
-        // try __setattr__ first
-        mp_obj_t attr_setattr_method[4];
-        mp_load_method_maybe(self_in, MP_QSTR___setattr__, attr_setattr_method);
-        if (attr_setattr_method[0] != MP_OBJ_NULL) {
-            // __setattr__ exists, so call it
-            attr_setattr_method[2] = MP_OBJ_NEW_QSTR(attr);
-            attr_setattr_method[3] = value;
-            mp_call_method_n_kw(2, 0, attr_setattr_method);
-            return true;
-        }
+        memcpy(self->tx_buf, pixels, len);
     }
-    #endif
+}
 
-skip_special_accessors:
+// Strips are numbered in order of creation for the neopixelhal hooks; object
+// addresses don't fit in an int on a 64-bit host.
+STATIC int neopixel_last_hal_id;
 
-    if (value == MP_OBJ_NULL) {
-        // delete attribute
-        mp_map_elem_t *elem = mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(attr), MP_MAP_LOOKUP_REMOVE_IF_FOUND);
-        return elem != NULL;
+// Default for backends that only implement neopixel_hal_write: send them the
+// strip up to the end of the modified range.
+MP_WEAK void neopixel_hal_write_range(int id, size_t offset, size_t length, const uint8_t *buf) {
+    neopixel_hal_write(id, offset + length, buf - offset);
+}
+
+// Pass the data that was sent to the strip on to the simulator hooks, and reset
+// the dirty range.
+STATIC void neopixel_write_hal(neopixel_obj_t *self, const uint8_t *out) {
+    if (self->dirty_start == 0 && self->dirty_end == self->num_pixels) {
+        neopixel_hal_write(self->hal_id, neopixel_buf_len(self), out);
     } else {
-        // store attribute
-        mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(attr), MP_MAP_LOOKUP_ADD_IF_NOT_FOUND)->value = value;
-        return true;
+        size_t offset = self->dirty_start * self->bpp;
+        size_t length = (self->dirty_end - self->dirty_start) * self->bpp;
+        neopixel_hal_write_range(self->hal_id, offset, length, out + offset);
     }
+    self->dirty_start = self->num_pixels;
+    self->dirty_end = 0;
 }
 
-STATIC void mp_obj_NeoPixel_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
-    if (dest[0] == MP_OBJ_NULL) {
-        mp_obj_NeoPixel_load_attr(self_in, attr, dest);
+// Start clocking out tx_buf in the background.  The DMA driver must be idle.
+// Returns false if the PWM peripheral is in use by something else.
+STATIC bool neopixel_write_async(neopixel_obj_t *self) {
+    // Keep the snapshot reachable by the GC until the transfer is done.
+    MP_STATE_PORT(neopixel_tx_buf) = self->tx_buf;
+    return microbit_hal_pin_write_ws2812_async(self->pin, self->tx_buf, neopixel_buf_len(self)) == MICROBIT_HAL_DEVICE_OK;
+}
+
+STATIC void neopixel_anim_stop(neopixel_obj_t *self);
+
+// Push the strip out if anything changed since the last write.  WS2812 strips
+// must always be sent in full, but the simulator hook only gets the modified span.
+// If wait is false then a snapshot of the pixels is clocked out in the background
+// by DMA, so the buffer can be modified straight away.  Writing from Python
+// takes the strip over from any background effect.
+STATIC void neopixel_write(neopixel_obj_t *self, bool wait) {
+    neopixel_anim_stop(self);
+    if (self->buf_exported) {
+        neopixel_mark_dirty(self, 0, self->num_pixels);
+    }
+    if (self->dirty_start >= self->dirty_end) {
+        return;
+    }
+    size_t len = neopixel_buf_len(self);
+    const uint8_t *out = neopixel_pixels(self);
+    if ((self->lut != NULL || !wait) && self->tx_buf == NULL) {
+        self->tx_buf = m_new(uint8_t, len);
+    }
+
+    if (wait) {
+        mp_uint_t atomic_state = neopixel_claim_tx();
+        if (self->lut != NULL) {
+            neopixel_render_tx(self);
+            out = self->tx_buf;
+        }
+        microbit_hal_pin_write_ws2812(self->pin, out, len);
+        MICROPY_END_ATOMIC_SECTION(atomic_state);
     } else {
-        if (mp_obj_NeoPixel_store_attr(self_in, attr, dest[1])) {
-            dest[0] = MP_OBJ_NULL; // indicate success
+        mp_uint_t atomic_state = neopixel_claim_tx();
+        neopixel_render_tx(self);
+        if (!neopixel_write_async(self)) {
+            // The PWM is owned elsewhere, so send it the blocking way instead.
+            microbit_hal_pin_write_ws2812(self->pin, self->tx_buf, len);
         }
+        MICROPY_END_ATOMIC_SECTION(atomic_state);
+        out = self->tx_buf;
     }
+    neopixel_write_hal(self, out);
 }
 
-mp_obj_t mp_obj_NeoPixel_make_new(const mp_obj_type_t *self, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+// Get the NeoPixel object from an instance of NeoPixel or a subclass of it.
+STATIC neopixel_obj_t *neopixel_get_strip(mp_obj_t obj) {
+    mp_obj_t native = mp_obj_cast_to_native_base(obj, MP_OBJ_FROM_PTR(&mod_NeoPixel_type));
+    if (native == MP_OBJ_NULL) {
+        mp_raise_TypeError(MP_ERROR_TEXT("expecting a NeoPixel object"));
+    }
+    return MP_OBJ_TO_PTR(native);
+}
 
-    // look for __new__ function
-    mp_obj_t init_fn[2] = {MP_OBJ_NULL};
-    struct class_lookup_data lookup = {
-        .obj = NULL,
-        .attr = MP_QSTR___new__,
-        .meth_offset = offsetof(mp_obj_type_t, make_new),
-        .dest = init_fn,
-        .is_type = false,
-    };
-    mp_obj_class_lookup(&lookup, self);
-
-    const mp_obj_type_t *native_base = NULL;
-    mp_obj_instance_t *o;
-    // create a blank instance.
-    o = mp_obj_new_instance(self, &native_base);
-    // now call Python class __init__ function with all args
-    init_fn[0] = init_fn[1] = MP_OBJ_NULL;
-    lookup.obj = o;
-    lookup.attr = MP_QSTR___init__;
-    lookup.meth_offset = 0;
-    mp_obj_class_lookup(&lookup, self);
-    if (init_fn[0] != MP_OBJ_NULL) {
-        mp_obj_t init_ret;
-        if (n_args == 0 && n_kw == 0) {
-         	//Not used
-            init_ret = mp_call_method_n_kw(0, 0, init_fn);
-        } else {
-            mp_obj_t *args2 = m_new(mp_obj_t, 2 + n_args + 2 * n_kw);
-            args2[0] = init_fn[0];
-            args2[1] = init_fn[1];
-            memcpy(args2 + 2, args, (n_args + 2 * n_kw) * sizeof(mp_obj_t));
-            init_ret = mp_call_method_n_kw(n_args, n_kw, args2);
-            m_del(mp_obj_t, args2, 2 + n_args + 2 * n_kw);
-        }
-        if (init_ret != mp_const_none) {
-            #if MICROPY_ERROR_REPORTING <= MICROPY_ERROR_REPORTING_TERSE
-            mp_raise_TypeError(MP_ERROR_TEXT("__init__() should return None"));
-            #else
-            mp_raise_msg_varg(&mp_type_TypeError,
-                MP_ERROR_TEXT("__init__() should return None, not '%s'"), mp_obj_get_type_str(init_ret));
-            #endif
+// Rebuild the output lookup table after the brightness or gamma changed.  A
+// background effect keeps running with the new table, so it's swapped in with
+// interrupts disabled.
+STATIC void neopixel_update_lut(neopixel_obj_t *self) {
+    uint8_t lut[256];
+    uint8_t *dest = NULL;
+    if (self->brightness != 255 || self->gamma != NULL) {
+        for (size_t i = 0; i < 256; ++i) {
+            size_t value = self->gamma == NULL ? i : self->gamma[i];
+            lut[i] = (value * self->brightness + 127) / 255;
         }
+        dest = self->lut != NULL ? self->lut : m_new(uint8_t, 256);
     }
+    mp_uint_t atomic_state = MICROPY_BEGIN_ATOMIC_SECTION();
+    if (dest != NULL) {
+        memcpy(dest, lut, 256);
+    }
+    self->lut = dest;
+    // Every pixel now looks different on the strip.
+    neopixel_mark_dirty(self, 0, self->num_pixels);
+    MICROPY_END_ATOMIC_SECTION(atomic_state);
+}
 
-    return MP_OBJ_FROM_PTR(o);
+/******************************************************************************/
+// Background effects, advanced from the soft timer at interrupt priority.
+
+typedef struct _neopixel_anim_t {
+    microbit_soft_timer_entry_t timer;
+    // Set to NULL when the effect is stopped.
+    neopixel_obj_t *strip;
+    uint8_t effect;
+    uint8_t num_colors;
+    uint16_t size;
+    uint32_t step;
+    uint32_t rand_state;
+    // Colours in wire order.
+    uint8_t colors[NEOPIXEL_ANIM_MAX_COLORS][4];
+} neopixel_anim_t;
+
+STATIC uint32_t neopixel_anim_rand(neopixel_anim_t *anim) {
+    // xorshift32
+    uint32_t x = anim->rand_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    anim->rand_state = x;
+    return x;
 }
 
-STATIC void NeoPixel_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
-	assert_neopixel(self_in);
-	mp_obj_instance_t *self = MP_OBJ_TO_PTR(self_in);
-	mp_printf(print, "<%s object at %p>", mp_obj_get_type_str(self_in), self);
+STATIC void neopixel_store_rgb(neopixel_obj_t *self, uint8_t *pixel, uint8_t r, uint8_t g, uint8_t b) {
+    pixel[self->order & 0xf] = r;
+    pixel[(self->order >> 4) & 0xf] = g;
+    pixel[(self->order >> 8) & 0xf] = b;
 }
 
-STATIC mp_obj_t NeoPixel_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value) {
-	assert_neopixel(self_in);
-    mp_obj_instance_t *self = MP_OBJ_TO_PTR(self_in);
-    mp_obj_t member[4] = {MP_OBJ_NULL, MP_OBJ_NULL, index, value};
-    struct class_lookup_data lookup = {
-        .obj = self,
-        .meth_offset = offsetof(mp_obj_type_t, subscr),
-        .dest = member,
-        .is_type = false,
-    };
-    if (value == MP_OBJ_NULL) {
-        // delete item
-        lookup.attr = MP_QSTR___delitem__;
-    } else if (value == MP_OBJ_SENTINEL) {
-        // load item
-        lookup.attr = MP_QSTR___getitem__;
-    } else {
-        // store item
-        lookup.attr = MP_QSTR___setitem__;
-    }
-    mp_obj_class_lookup(&lookup, self->base.type);
-    if (member[0] == MP_OBJ_SENTINEL) {
-        return mp_obj_subscr(self->subobj[0], index, value);
-    } else if (member[0] != MP_OBJ_NULL) {
-        size_t n_args = value == MP_OBJ_NULL || value == MP_OBJ_SENTINEL ? 1 : 2;
-        mp_obj_t ret = mp_call_method_n_kw(n_args, 0, member);
-        if (value == MP_OBJ_SENTINEL) {
-            return ret;
-        } else {
-            return mp_const_none;
-        }
+// Map an 8-bit position on the colour wheel to a fully saturated colour.
+STATIC void neopixel_wheel(neopixel_obj_t *self, uint8_t *pixel, uint8_t pos) {
+    uint8_t third = pos % 85 * 3;
+    if (pos < 85) {
+        neopixel_store_rgb(self, pixel, 255 - third, third, 0);
+    } else if (pos < 170) {
+        neopixel_store_rgb(self, pixel, 0, 255 - third, third);
     } else {
-        return MP_OBJ_NULL; // op not supported
+        neopixel_store_rgb(self, pixel, third, 0, 255 - third);
     }
 }
 
-STATIC mp_obj_t NeoPixel_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
-	assert_neopixel(self_in);
-	mp_obj_instance_t *self = MP_OBJ_TO_PTR(self_in);
-    qstr op_name = mp_unary_op_method_name[op];
-    /* Still try to lookup native slot
-    if (op_name == 0) {
-        return MP_OBJ_NULL;
+// Convert an 8-bit hue, saturation and value to a pixel using integer arithmetic.
+// The hue circle is split into six regions of 43 steps.
+STATIC void neopixel_hsv(neopixel_obj_t *self, uint8_t *pixel, uint8_t h, uint8_t s, uint8_t v) {
+    unsigned int region = h / 43;
+    unsigned int rem = (h - region * 43) * 6;
+    uint8_t p = v * (255 - s) >> 8;
+    uint8_t q = v * (255 - (s * rem >> 8)) >> 8;
+    uint8_t t = v * (255 - (s * (255 - rem) >> 8)) >> 8;
+    switch (region) {
+        case 0: neopixel_store_rgb(self, pixel, v, t, p); break;
+        case 1: neopixel_store_rgb(self, pixel, q, v, p); break;
+        case 2: neopixel_store_rgb(self, pixel, p, v, t); break;
+        case 3: neopixel_store_rgb(self, pixel, p, q, v); break;
+        case 4: neopixel_store_rgb(self, pixel, t, p, v); break;
+        default: neopixel_store_rgb(self, pixel, v, p, q); break;
     }
-    */
-    mp_obj_t member[2] = {MP_OBJ_NULL};
-    struct class_lookup_data lookup = {
-        .obj = self,
-        .attr = op_name,
-        .meth_offset = offsetof(mp_obj_type_t, unary_op),
-        .dest = member,
-        .is_type = false,
-    };
-    mp_obj_class_lookup(&lookup, self->base.type);
-    if (member[0] == MP_OBJ_SENTINEL) {
-        return mp_unary_op(op, self->subobj[0]);
-    } else if (member[0] != MP_OBJ_NULL) {
-        mp_obj_t val = mp_call_function_1(member[0], self_in);
-
-        switch (op) {
-            case MP_UNARY_OP_HASH:
-                // __hash__ must return a small int
-                val = MP_OBJ_NEW_SMALL_INT(mp_obj_get_int_truncated(val));
-                break;
-            case MP_UNARY_OP_INT:
-                // Must return int
-                if (!mp_obj_is_int(val)) {
-                    mp_raise_TypeError(NULL);
+}
+
+// Scale a wire-order pixel by level/256 into dest.
+STATIC void neopixel_scale_pixel(uint8_t *dest, const uint8_t *src, size_t bpp, unsigned int level) {
+    for (size_t i = 0; i < bpp; ++i) {
+        dest[i] = src[i] * level >> 8;
+    }
+}
+
+STATIC void neopixel_anim_render(neopixel_anim_t *anim) {
+    neopixel_obj_t *self = anim->strip;
+    size_t n = self->num_pixels;
+    size_t bpp = self->bpp;
+    uint8_t *pixels = neopixel_pixels(self);
+    uint32_t step = anim->step++;
+
+    switch (anim->effect) {
+        case NEOPIXEL_EFFECT_RAINBOW:
+            for (size_t i = 0; i < n; ++i) {
+                neopixel_wheel(self, pixels + i * bpp, (i * 256 / n + step) & 0xff);
+            }
+            break;
+
+        case NEOPIXEL_EFFECT_CHASE: {
+            // Every size'th pixel lit with the first colour, moving one pixel per step.
+            // The remaining pixels take the second colour, if given.
+            const uint8_t *off = anim->colors[1];
+            size_t offset = step % anim->size;
+            for (size_t i = 0; i < n; ++i) {
+                memcpy(pixels + i * bpp, i % anim->size == offset ? anim->colors[0] : off, bpp);
+            }
+            break;
+        }
+
+        case NEOPIXEL_EFFECT_COMET: {
+            // A head moving along the strip with a tail of size pixels fading out.
+            size_t head = step % (n + anim->size);
+            for (size_t i = 0; i < n; ++i) {
+                unsigned int level = 0;
+                if (i <= head && head - i < anim->size) {
+                    level = 256 - (head - i) * 256 / anim->size;
                 }
-                break;
-            default:
-                // No need to do anything
-                ;
+                neopixel_scale_pixel(pixels + i * bpp, anim->colors[0], bpp, level);
+            }
+            break;
         }
-        return val;
-    } else {
-        if (op == MP_UNARY_OP_HASH) {
-            lookup.attr = MP_QSTR___eq__;
-            mp_obj_class_lookup(&lookup, self->base.type);
-            if (member[0] == MP_OBJ_NULL) {
-                // https://docs.python.org/3/reference/datamodel.html#object.__hash__
-                // "User-defined classes have __eq__() and __hash__() methods by default;
-                // with them, all objects compare unequal (except with themselves) and
-                // x.__hash__() returns an appropriate value such that x == y implies
-                // both that x is y and hash(x) == hash(y)."
-                return MP_OBJ_NEW_SMALL_INT((mp_uint_t)self_in);
+
+        case NEOPIXEL_EFFECT_TWINKLE: {
+            // Decay everything a little and light up a random pixel.
+            size_t len = n * bpp;
+            for (size_t i = 0; i < len; ++i) {
+                pixels[i] -= pixels[i] >> 3;
             }
-            // "A class that overrides __eq__() and does not define __hash__() will have its __hash__() implicitly set to None.
-            // When the __hash__() method of a class is None, instances of the class will raise an appropriate TypeError"
+            uint32_t r = neopixel_anim_rand(anim);
+            memcpy(pixels + (r % n) * bpp, anim->colors[(r >> 16) % anim->num_colors], bpp);
+            break;
         }
 
-        return MP_OBJ_NULL; // op not supported
+        case NEOPIXEL_EFFECT_FADE: {
+            // Cross-fade the whole strip through the colours, size steps per fade.
+            size_t k = step / anim->size % anim->num_colors;
+            const uint8_t *from = anim->colors[k];
+            const uint8_t *to = anim->colors[(k + 1) % anim->num_colors];
+            unsigned int t = step % anim->size * 256 / anim->size;
+            uint8_t pixel[4];
+            for (size_t i = 0; i < bpp; ++i) {
+                pixel[i] = (from[i] * (256 - t) + to[i] * t) >> 8;
+            }
+            neopixel_fill_pattern(pixels, n * bpp, pixel, bpp);
+            break;
+        }
     }
+
+    neopixel_mark_dirty(self, 0, n);
 }
 
-//End of copied section
+// Soft timer callback, called at interrupt priority so it must not allocate.
+STATIC void neopixel_anim_callback(microbit_soft_timer_entry_t *entry) {
+    neopixel_anim_t *anim = (neopixel_anim_t *)entry;
+    neopixel_obj_t *self = anim->strip;
+    if (self == NULL) {
+        return;
+    }
+    if (microbit_hal_pin_ws2812_busy()) {
+        // Previous frame (of this or another strip) is still going out, skip this one.
+        return;
+    }
+    neopixel_anim_render(anim);
+    neopixel_render_tx(self);
+    neopixel_write_async(self);
+    neopixel_write_hal(self, self->tx_buf);
+}
 
-STATIC const mp_obj_tuple_t mod_neopixel_ORDER_obj = {
-    {&mp_type_tuple},
-    4,
-    {
-      	MP_OBJ_NEW_SMALL_INT(COLOR_INDEX_RED),
-        MP_OBJ_NEW_SMALL_INT(COLOR_INDEX_GREEN),
-        MP_OBJ_NEW_SMALL_INT(COLOR_INDEX_BLUE),
-        MP_OBJ_NEW_SMALL_INT(COLOR_INDEX_WHITE)
+STATIC void neopixel_anim_stop(neopixel_obj_t *self) {
+    if (self->anim != NULL) {
+        // The timer can't be removed from the heap, so disable it and let it expire.
+        self->anim->strip = NULL;
+        self->anim->timer.mode = MICROBIT_SOFT_TIMER_MODE_ONE_SHOT;
+        self->anim = NULL;
     }
-};
+}
+
+// Parse layout=(w, h[, serpentine[, origin]]) and build the coordinate map.
+STATIC void neopixel_init_layout(neopixel_obj_t *self, mp_obj_t layout_in) {
+    size_t len;
+    mp_obj_t *items;
+    mp_obj_get_array(layout_in, &len, &items);
+    if (len < 2 || len > 4) {
+        mp_raise_ValueError(MP_ERROR_TEXT("invalid layout"));
+    }
+    mp_int_t w = mp_obj_get_int(items[0]);
+    mp_int_t h = mp_obj_get_int(items[1]);
+    bool serpentine = len > 2 && mp_obj_is_true(items[2]);
+    mp_int_t origin = len > 3 ? mp_obj_get_int(items[3]) : NEOPIXEL_ORIGIN_TOP_LEFT;
+    // Bound each side before multiplying so that w * h cannot overflow.
+    if (w <= 0 || h <= 0 || w > 0xffff || h > 0xffff
+        || (size_t)h > self->num_pixels / (size_t)w || w * h > 0xffff
+        || origin < NEOPIXEL_ORIGIN_TOP_LEFT || origin > NEOPIXEL_ORIGIN_BOTTOM_RIGHT) {
+        mp_raise_ValueError(MP_ERROR_TEXT("invalid layout"));
+    }
+
+    self->width = w;
+    self->height = h;
+    self->layout = m_new(uint16_t, w * h);
+    bool flip_x = origin == NEOPIXEL_ORIGIN_TOP_RIGHT || origin == NEOPIXEL_ORIGIN_BOTTOM_RIGHT;
+    bool flip_y = origin == NEOPIXEL_ORIGIN_BOTTOM_LEFT || origin == NEOPIXEL_ORIGIN_BOTTOM_RIGHT;
+    for (mp_int_t y = 0; y < h; ++y) {
+        mp_int_t row = flip_y ? h - 1 - y : y;
+        for (mp_int_t x = 0; x < w; ++x) {
+            mp_int_t col = flip_x ? w - 1 - x : x;
+            if (serpentine && (row & 1)) {
+                col = w - 1 - col;
+            }
+            self->layout[y * w + x] = row * w + col;
+        }
+    }
+}
 
-STATIC mp_obj_t mod_neopixel___init___func(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
-	mp_obj_instance_t *self = MP_OBJ_TO_PTR(pos_args[0]);
-    const mp_obj_t *sub_args = &pos_args[1];
-    size_t sub_n_args = n_args - 1;
+// Convert panel coordinates to a pixel index.
+STATIC size_t neopixel_get_xy_index(neopixel_obj_t *self, mp_obj_t x_in, mp_obj_t y_in) {
+    if (self->layout == NULL) {
+        mp_raise_ValueError(MP_ERROR_TEXT("no layout"));
+    }
+    mp_int_t x = mp_obj_get_int(x_in);
+    mp_int_t y = mp_obj_get_int(y_in);
+    if (x < 0 || x >= self->width || y < 0 || y >= self->height) {
+        mp_raise_msg(&mp_type_IndexError, MP_ERROR_TEXT("index out of bounds"));
+    }
+    return self->layout[y * self->width + x];
+}
 
-	enum { ARG_pin, ARG_n, ARG_bpp };
+STATIC mp_obj_t mod_neopixel_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args) {
+    enum { ARG_pin, ARG_n, ARG_bpp, ARG_order, ARG_layout };
     static const mp_arg_t allowed_args[] = {
         { MP_QSTR_pin, MP_ARG_REQUIRED | MP_ARG_OBJ },
         { MP_QSTR_n, MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0} },
-        { MP_QSTR_bpp, MP_ARG_INT, {.u_int = 3} },
+        { MP_QSTR_bpp, MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_order, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_rom_obj = MP_ROM_NONE} },
+        { MP_QSTR_layout, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_rom_obj = MP_ROM_NONE} },
     };
-    mp_arg_val_t vals[MP_ARRAY_SIZE(allowed_args)];
-    mp_arg_parse_all(sub_n_args, sub_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, vals);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
-    mp_int_t num_pixels = vals[ARG_n].u_int;
-    mp_int_t bytes_per_pixel = vals[ARG_bpp].u_int;
+    mp_int_t num_pixels = args[ARG_n].u_int;
+    mp_int_t bytes_per_pixel = args[ARG_bpp].u_int;
 
     if (num_pixels <= 0) {
-        mp_raise_ValueError(MP_ERROR_TEXT("invalid number of pixels"));;
+        mp_raise_ValueError(MP_ERROR_TEXT("invalid number of pixels"));
     }
 
-    if (!(bytes_per_pixel == 3 || bytes_per_pixel == 4)) {
+    // bpp defaults to 3, or to the length of order if that is given.
+    const neopixel_format_t *format = neopixel_get_format(args[ARG_order].u_obj, bytes_per_pixel == 0 ? 3 : bytes_per_pixel);
+    if (bytes_per_pixel == 0) {
+        bytes_per_pixel = format->bpp;
+    } else if (bytes_per_pixel != format->bpp) {
         mp_raise_ValueError(MP_ERROR_TEXT("invalid bpp"));
     }
-	self->base.type = &mod_NeoPixel_type;
-	mp_store_attr(self,MP_QSTR_pin,vals[ARG_pin].u_obj);
-	mp_store_attr(self,MP_QSTR_n,MP_OBJ_NEW_SMALL_INT(vals[ARG_n].u_int));
-	mp_store_attr(self,MP_QSTR_bpp,MP_OBJ_NEW_SMALL_INT(vals[ARG_bpp].u_int));
-
-    size_t buf_size = vals[ARG_bpp].u_int * vals[ARG_n].u_int;
-    mp_obj_t bytearray_obj = mp_obj_new_bytearray(buf_size, NULL);
-	mp_obj_array_t *bytearray_data = MP_OBJ_TO_PTR(bytearray_obj);
-	size_t len = bytearray_data->len;
-	memset(bytearray_data->items, 0, len);
-	mp_store_attr(self,MP_QSTR_buf,bytearray_obj);
-
-    mp_buffer_info_t buf_info;
-    mp_get_buffer_raise(bytearray_obj, &buf_info, MP_BUFFER_READ);
-    microbit_pin_obj_t* pin = (microbit_pin_obj_t*)microbit_obj_get_pin(vals[ARG_pin].u_obj);
-    uintptr_t id = (uintptr_t)self;
-    uint8_t pin_hal = pin->name;
-    uint8_t n_hal = (uint8_t)mp_obj_get_int(MP_OBJ_NEW_SMALL_INT(vals[ARG_n].u_int));
-    uint8_t bpp_hal = (uint8_t)mp_obj_get_int(MP_OBJ_NEW_SMALL_INT(vals[ARG_bpp].u_int));
-    neopixel_hal_NeoPixel(id,pin_hal,n_hal,bpp_hal,buf_info.buf);
 
-    return mp_const_none;
+    const microbit_pin_obj_t *pin = microbit_obj_get_pin(args[ARG_pin].u_obj);
+
+    neopixel_obj_t *self = m_new_obj(neopixel_obj_t);
+    self->base.type = type;
+    self->pin_obj = args[ARG_pin].u_obj;
+    self->pin = pin->name;
+    self->bpp = bytes_per_pixel;
+    self->order = format->map;
+    self->format = format;
+    self->buf_exported = false;
+    self->num_pixels = num_pixels;
+    // The first write always sends the whole strip.
+    self->dirty_start = 0;
+    self->dirty_end = num_pixels;
+    self->buf = MP_OBJ_TO_PTR(mp_obj_new_bytearray(num_pixels * bytes_per_pixel, NULL));
+    self->tx_buf = NULL;
+    self->brightness = 255;
+    self->gamma = NULL;
+    self->lut = NULL;
+    self->anim = NULL;
+    self->width = 0;
+    self->height = 0;
+    self->layout = NULL;
+    memset(self->buf->items, 0, self->buf->len);
+
+    if (args[ARG_layout].u_obj != mp_const_none) {
+        neopixel_init_layout(self, args[ARG_layout].u_obj);
+    }
+
+    self->hal_id = ++neopixel_last_hal_id;
+    neopixel_hal_NeoPixel(self->hal_id, self->pin, self->num_pixels, self->bpp, neopixel_pixels(self));
+
+    return MP_OBJ_FROM_PTR(self);
+}
+
+STATIC void mod_neopixel_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+    mp_printf(print, "<%s object at %p>", mp_obj_get_type_str(self_in), MP_OBJ_TO_PTR(self_in));
 }
 
-MP_DEFINE_CONST_FUN_OBJ_KW(mod_neopixel___init___obj,2, mod_neopixel___init___func);
+STATIC void mod_neopixel_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (dest[0] != MP_OBJ_NULL) {
+        // Fields are read-only, leave dest[0] set so the store fails.
+        return;
+    }
+    if (attr == MP_QSTR_pin) {
+        dest[0] = self->pin_obj;
+    } else if (attr == MP_QSTR_n) {
+        dest[0] = MP_OBJ_NEW_SMALL_INT(self->num_pixels);
+    } else if (attr == MP_QSTR_bpp) {
+        dest[0] = MP_OBJ_NEW_SMALL_INT(self->bpp);
+    } else if (attr == MP_QSTR_order) {
+        dest[0] = MP_OBJ_NEW_QSTR(self->format->name);
+    } else if (attr == MP_QSTR_ORDER) {
+        dest[0] = MP_OBJ_FROM_PTR(self->format->order_tuple);
+    } else if (attr == MP_QSTR_buf) {
+        self->buf_exported = true;
+        dest[0] = MP_OBJ_FROM_PTR(self->buf);
+    } else {
+        // Not a field, set MP_OBJ_SENTINEL to continue lookup in locals dict.
+        dest[1] = MP_OBJ_SENTINEL;
+    }
+}
 
-STATIC mp_obj_t mod_neopixel___len___func(mp_obj_t self_in) {
-    mp_obj_instance_t *self = MP_OBJ_TO_PTR(self_in);
-    mp_map_elem_t *elem = mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(MP_QSTR_n), MP_MAP_LOOKUP);
-    mp_obj_t n_value = elem->value;
-    return MP_OBJ_NEW_SMALL_INT(mp_obj_get_int(n_value));
+STATIC mp_obj_t mod_neopixel_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    switch (op) {
+        case MP_UNARY_OP_LEN:
+            return MP_OBJ_NEW_SMALL_INT(self->num_pixels);
+        default:
+            return MP_OBJ_NULL; // op not supported
+    }
 }
 
-MP_DEFINE_CONST_FUN_OBJ_1(mod_neopixel___len___obj, mod_neopixel___len___func);
+STATIC mp_obj_t mod_neopixel_subscr(mp_obj_t self_in, mp_obj_t index_in, mp_obj_t value) {
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (value == MP_OBJ_NULL) {
+        // delete item
+        return MP_OBJ_NULL; // op not supported
+    }
+    if (value != MP_OBJ_SENTINEL && mp_obj_is_type(index_in, &mp_type_slice)) {
+        // store slice
+        neopixel_set_slice(self, index_in, value);
+        return mp_const_none;
+    }
+    size_t index;
+    if (mp_obj_is_type(index_in, &mp_type_tuple)) {
+        // np[x, y] on a panel
+        mp_obj_t *xy;
+        mp_obj_get_array_fixed_n(index_in, 2, &xy);
+        index = neopixel_get_xy_index(self, xy[0], xy[1]);
+    } else {
+        index = mp_get_index(self->base.type, self->num_pixels, index_in, false);
+    }
+    if (value == MP_OBJ_SENTINEL) {
+        // load item
+        return neopixel_get_pixel(self, index);
+    } else {
+        // store item
+        neopixel_set_pixel(self, index, value);
+        return mp_const_none;
+    }
+}
 
-mp_obj_t mod_neopixel___set_item___func(mp_obj_t self_in, mp_obj_t index_in, mp_obj_t value) {
-    mp_obj_instance_t *self = MP_OBJ_TO_PTR(self_in);
-    size_t index = mp_obj_get_int(index_in);
-    mp_obj_t *rgb;
-    size_t len;
-    mp_obj_tuple_get(value, &len, &rgb);
-    index = index*len;
-    mp_map_elem_t *elem = mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(MP_QSTR_buf), MP_MAP_LOOKUP);
-    mp_obj_array_t *pixel_array = MP_OBJ_TO_PTR(elem->value);
-    for (uint8_t i = 0; i < len; ++i) {
-        mp_int_t color = mp_obj_get_int(rgb[i]);
-        if (color > 255) {
-        	color = color % 255;
+STATIC mp_obj_t mod_neopixel_xy_func(mp_obj_t self_in, mp_obj_t x_in, mp_obj_t y_in) {
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    return MP_OBJ_NEW_SMALL_INT(neopixel_get_xy_index(self, x_in, y_in));
+}
+MP_DEFINE_CONST_FUN_OBJ_3(mod_neopixel_xy_obj, mod_neopixel_xy_func);
+
+STATIC mp_obj_t mod_neopixel_blit_func(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_image, ARG_x, ARG_y, ARG_color, ARG_palette };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_image, MP_ARG_REQUIRED | MP_ARG_OBJ },
+        { MP_QSTR_x, MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_y, MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_color, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_NONE} },
+        { MP_QSTR_palette, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_rom_obj = MP_ROM_NONE} },
+    };
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(pos_args[0]);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if (mp_obj_get_type(args[ARG_image].u_obj) != &microbit_image_type) {
+        mp_raise_TypeError(MP_ERROR_TEXT("expecting an image"));
+    }
+    microbit_image_obj_t *image = MP_OBJ_TO_PTR(args[ARG_image].u_obj);
+    if (self->layout == NULL) {
+        mp_raise_ValueError(MP_ERROR_TEXT("no layout"));
+    }
+
+    // Build the brightness to wire-order pixel lookup table.
+    uint8_t lut[MICROBIT_DISPLAY_MAX_BRIGHTNESS + 1][4] = {{0}};
+    if (args[ARG_palette].u_obj != mp_const_none) {
+        // Brightness levels are spread evenly across the given palette.
+        size_t len;
+        mp_obj_t *palette;
+        mp_obj_get_array(args[ARG_palette].u_obj, &len, &palette);
+        if (len == 0 || len > MICROBIT_DISPLAY_MAX_BRIGHTNESS + 1) {
+            mp_raise_ValueError(MP_ERROR_TEXT("invalid palette"));
+        }
+        for (size_t b = 0; b <= MICROBIT_DISPLAY_MAX_BRIGHTNESS; ++b) {
+            neopixel_parse_color(self, palette[b * (len - 1) / MICROBIT_DISPLAY_MAX_BRIGHTNESS], lut[b]);
+        }
+    } else {
+        // Brightness levels scale a single colour, white by default.
+        uint8_t color[4] = {0};
+        if (args[ARG_color].u_obj != mp_const_none) {
+            neopixel_parse_color(self, args[ARG_color].u_obj, color);
+        } else {
+            neopixel_store_rgb(self, color, 255, 255, 255);
         }
-        if (color < 0) {
-            mp_raise_ValueError(MP_ERROR_TEXT("invalid color"));
+        for (size_t b = 0; b <= MICROBIT_DISPLAY_MAX_BRIGHTNESS; ++b) {
+            for (size_t i = 0; i < self->bpp; ++i) {
+                lut[b][i] = color[i] * b / MICROBIT_DISPLAY_MAX_BRIGHTNESS;
+            }
+        }
+    }
+
+    // Clip the image to the panel.
+    mp_int_t x0 = args[ARG_x].u_int;
+    mp_int_t y0 = args[ARG_y].u_int;
+    mp_int_t x_start = MAX(0, -x0);
+    mp_int_t y_start = MAX(0, -y0);
+    mp_int_t x_end = MIN(image_width(image), (mp_int_t)self->width - x0);
+    mp_int_t y_end = MIN(image_height(image), (mp_int_t)self->height - y0);
+
+    uint8_t *pixels = neopixel_pixels(self);
+    size_t bpp = self->bpp;
+    size_t first = self->num_pixels;
+    size_t last = 0;
+    for (mp_int_t y = y_start; y < y_end; ++y) {
+        mp_int_t row = (y0 + y) * self->width + x0;
+        for (mp_int_t x = x_start; x < x_end; ++x) {
+            size_t index = self->layout[row + x];
+            memcpy(pixels + index * bpp, lut[image_get_pixel(image, x, y)], bpp);
+            first = MIN(first, index);
+            last = MAX(last, index);
         }
-        size_t index_now = index + ((COLOR_INDEX_MAP >> (4 * i)) & 0xf);
-        ((uint8_t *)pixel_array->items)[index_now] = color;
+    }
+    if (first <= last) {
+        neopixel_mark_dirty(self, first, last + 1);
     }
     return mp_const_none;
 }
-MP_DEFINE_CONST_FUN_OBJ_3(mod_neopixel___set_item___obj, mod_neopixel___set_item___func);
-
-mp_obj_t mod_neopixel___get_item___func(mp_obj_t self_in, mp_obj_t index_in) {
-    mp_obj_instance_t *self = MP_OBJ_TO_PTR(self_in);
-    size_t index = mp_obj_get_int(index_in);
-    mp_map_elem_t *bpp_attr = mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(MP_QSTR_bpp), MP_MAP_LOOKUP);
-    size_t bpp = (size_t)mp_obj_get_int(bpp_attr->value);
-    size_t index_new = bpp * index;
-
-    mp_map_elem_t *elem = mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(MP_QSTR_buf), MP_MAP_LOOKUP);
-    mp_obj_array_t *pixel_array = MP_OBJ_TO_PTR(elem->value);
-    mp_obj_t rgb[] = {
-            MP_OBJ_NEW_SMALL_INT(((uint8_t*)pixel_array->items)[index_new + COLOR_INDEX_RED]),
-            MP_OBJ_NEW_SMALL_INT(((uint8_t*)pixel_array->items)[index_new + COLOR_INDEX_GREEN]),
-            MP_OBJ_NEW_SMALL_INT(((uint8_t*)pixel_array->items)[index_new + COLOR_INDEX_BLUE]),
-            MP_OBJ_NEW_SMALL_INT(((uint8_t*)pixel_array->items)[index_new + COLOR_INDEX_WHITE]),
-        };
-    return mp_obj_new_tuple(bpp, rgb);;
+MP_DEFINE_CONST_FUN_OBJ_KW(mod_neopixel_blit_obj, 2, mod_neopixel_blit_func);
+
+STATIC mp_obj_t mod_neopixel_fill_func(size_t n_args, const mp_obj_t *args) {
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+    size_t start = 0;
+    size_t end = self->num_pixels;
+    if (n_args > 2) {
+        start = neopixel_get_bound(self, args[2]);
+    }
+    if (n_args > 3) {
+        end = neopixel_get_bound(self, args[3]);
+    }
+    uint8_t pixel[4] = {0, 0, 0, 0};
+    neopixel_parse_color(self, args[1], pixel);
+    if (start < end) {
+        neopixel_fill_pattern(neopixel_pixels(self) + start * self->bpp, (end - start) * self->bpp, pixel, self->bpp);
+        neopixel_mark_dirty(self, start, end);
+    }
+    return mp_const_none;
 }
-MP_DEFINE_CONST_FUN_OBJ_2(mod_neopixel___get_item___obj, mod_neopixel___get_item___func);
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_neopixel_fill_obj, 2, 4, mod_neopixel_fill_func);
 
-STATIC mp_obj_t mod_neopixel_fill_func(mp_obj_t self_in, mp_obj_t color_tuple) {
-    mp_obj_instance_t *self = MP_OBJ_TO_PTR(self_in);
-    mp_map_elem_t *n_attr = mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(MP_QSTR_n), MP_MAP_LOOKUP);
-    size_t index = (size_t)mp_obj_get_int(n_attr->value);
+STATIC mp_obj_t mod_neopixel_set_buffer_func(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_buf, ARG_order };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf, MP_ARG_REQUIRED | MP_ARG_OBJ },
+        { MP_QSTR_order, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_NONE} },
+    };
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(pos_args[0]);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
-    for (size_t i = 0; i < index; ++i) {
-        mp_obj_t index_in = mp_obj_new_int(i);
-        NeoPixel_subscr(self_in, index_in, color_tuple);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[ARG_buf].u_obj, &bufinfo, MP_BUFFER_READ);
+    if (bufinfo.len % self->bpp != 0 || bufinfo.len > neopixel_buf_len(self)) {
+        mp_raise_ValueError(MP_ERROR_TEXT("buffer has wrong length"));
     }
-
+    mp_obj_t order_in = args[ARG_order].u_obj == mp_const_none ? MP_OBJ_NULL : args[ARG_order].u_obj;
+    neopixel_load_buffer(self, 0, bufinfo.len / self->bpp, &bufinfo, order_in);
     return mp_const_none;
 }
-MP_DEFINE_CONST_FUN_OBJ_2(mod_neopixel_fill_obj, mod_neopixel_fill_func);
+MP_DEFINE_CONST_FUN_OBJ_KW(mod_neopixel_set_buffer_obj, 2, mod_neopixel_set_buffer_func);
 
 STATIC mp_obj_t microbit_ws2812_write(mp_obj_t pin_in, mp_obj_t buf_in) {
     uint8_t pin = microbit_obj_get_pin(pin_in)->name;
     mp_buffer_info_t bufinfo;
     mp_get_buffer_raise(buf_in, &bufinfo, MP_BUFFER_READ);
+    mp_uint_t atomic_state = neopixel_claim_tx();
     microbit_hal_pin_write_ws2812(pin, bufinfo.buf, bufinfo.len);
+    MICROPY_END_ATOMIC_SECTION(atomic_state);
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(microbit_ws2812_write_obj, microbit_ws2812_write);
 
+STATIC uint8_t neopixel_get_byte_arg(mp_obj_t value_in) {
+    mp_int_t value = mp_obj_get_int(value_in);
+    if (value < 0 || value > 255) {
+        mp_raise_ValueError(MP_ERROR_TEXT("value out of range"));
+    }
+    return value;
+}
+
+// Fill a strip with a run of hues.  Hues are on the same 0-255 wheel as the
+// RAINBOW effect, and the step may be fractional so a full circle can span any
+// number of pixels; the hue is stepped in 16.16 fixed point.
+STATIC mp_obj_t mod_neopixel_hsv_fill(size_t n_args, const mp_obj_t *args) {
+    neopixel_obj_t *self = neopixel_get_strip(args[0]);
+    uint32_t hue = (int32_t)(mp_obj_get_float(args[1]) * 65536);
+    uint32_t step = (int32_t)(mp_obj_get_float(args[2]) * 65536);
+    uint8_t sat = n_args > 3 ? neopixel_get_byte_arg(args[3]) : 255;
+    uint8_t val = n_args > 4 ? neopixel_get_byte_arg(args[4]) : 255;
+    uint8_t *pixel = neopixel_pixels(self);
+    if (self->bpp == 4) {
+        memset(pixel, 0, neopixel_buf_len(self));
+    }
+    for (size_t i = 0; i < self->num_pixels; ++i) {
+        neopixel_hsv(self, pixel, hue >> 16, sat, val);
+        pixel += self->bpp;
+        hue += step;
+    }
+    neopixel_mark_dirty(self, 0, self->num_pixels);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_neopixel_hsv_fill_obj, 3, 5, mod_neopixel_hsv_fill);
+
+// Write several strips on different pins at the same time, so they all latch
+// together.  All strips are sent in full.
+STATIC mp_obj_t mod_neopixel_write_all(size_t n_args, const mp_obj_t *args) {
+    if (n_args > NEOPIXEL_WRITE_ALL_MAX_STRIPS) {
+        mp_raise_ValueError(MP_ERROR_TEXT("too many strips"));
+    }
+    neopixel_obj_t *strips[NEOPIXEL_WRITE_ALL_MAX_STRIPS];
+    int pins[NEOPIXEL_WRITE_ALL_MAX_STRIPS];
+    const uint8_t *bufs[NEOPIXEL_WRITE_ALL_MAX_STRIPS];
+    size_t lens[NEOPIXEL_WRITE_ALL_MAX_STRIPS];
+    for (size_t i = 0; i < n_args; ++i) {
+        strips[i] = neopixel_get_strip(args[i]);
+        neopixel_anim_stop(strips[i]);
+        if (strips[i]->lut != NULL && strips[i]->tx_buf == NULL) {
+            strips[i]->tx_buf = m_new(uint8_t, neopixel_buf_len(strips[i]));
+        }
+    }
+
+    mp_uint_t atomic_state = neopixel_claim_tx();
+    for (size_t i = 0; i < n_args; ++i) {
+        neopixel_obj_t *self = strips[i];
+        if (self->buf_exported) {
+            neopixel_mark_dirty(self, 0, self->num_pixels);
+        }
+        bufs[i] = neopixel_pixels(self);
+        if (self->lut != NULL) {
+            neopixel_render_tx(self);
+            bufs[i] = self->tx_buf;
+        }
+        pins[i] = self->pin;
+        lens[i] = neopixel_buf_len(self);
+    }
+
+    microbit_hal_pin_write_ws2812_multi(n_args, pins, bufs, lens);
+    MICROPY_END_ATOMIC_SECTION(atomic_state);
+
+    for (size_t i = 0; i < n_args; ++i) {
+        if (strips[i]->dirty_start < strips[i]->dirty_end) {
+            neopixel_write_hal(strips[i], bufs[i]);
+        }
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR(mod_neopixel_write_all_obj, 0, mod_neopixel_write_all);
+
 STATIC mp_obj_t mod_neopixel_write_func(mp_obj_t self_in) {
-    mp_obj_instance_t *self = MP_OBJ_TO_PTR(self_in);
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    neopixel_write(self, true);
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_1(mod_neopixel_write_obj, mod_neopixel_write_func);
 
-    mp_map_elem_t *pin_attr = mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(MP_QSTR_pin), MP_MAP_LOOKUP);
-    mp_obj_t pin_value = pin_attr->value;
+STATIC mp_obj_t mod_neopixel_show_func(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_wait };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_wait, MP_ARG_BOOL, {.u_bool = true} },
+    };
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(pos_args[0]);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+    neopixel_write(self, args[ARG_wait].u_bool);
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(mod_neopixel_show_obj, 1, mod_neopixel_show_func);
 
-    mp_map_elem_t *buf_attr = mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(MP_QSTR_buf), MP_MAP_LOOKUP);
-    mp_obj_t buf_value = buf_attr->value;
+STATIC mp_obj_t mod_neopixel_busy_func(mp_obj_t self_in) {
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    return mp_obj_new_bool(self->tx_buf != NULL
+        && MP_STATE_PORT(neopixel_tx_buf) == self->tx_buf
+        && microbit_hal_pin_ws2812_busy());
+}
+MP_DEFINE_CONST_FUN_OBJ_1(mod_neopixel_busy_obj, mod_neopixel_busy_func);
 
-    microbit_ws2812_write(pin_value,buf_value);
+STATIC mp_obj_t mod_neopixel_brightness_func(size_t n_args, const mp_obj_t *args) {
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+    if (n_args == 1) {
+        return MP_OBJ_NEW_SMALL_INT(self->brightness);
+    }
+    mp_int_t brightness = mp_obj_get_int(args[1]);
+    if (brightness < 0 || brightness > 255) {
+        mp_raise_ValueError(MP_ERROR_TEXT("brightness out of range"));
+    }
+    self->brightness = brightness;
+    neopixel_update_lut(self);
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_neopixel_brightness_obj, 1, 2, mod_neopixel_brightness_func);
+
+// Set the gamma curve: None for linear, a number for that gamma exponent, or a
+// 256-entry table of output values (a buffer, or a list/tuple of ints).
+STATIC mp_obj_t mod_neopixel_gamma_func(mp_obj_t self_in, mp_obj_t gamma_in) {
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (gamma_in == mp_const_none) {
+        self->gamma = NULL;
+        neopixel_update_lut(self);
+        return mp_const_none;
+    }
 
-    uintptr_t id = (uintptr_t)self;
-    mp_map_elem_t *n_attr = mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(MP_QSTR_n), MP_MAP_LOOKUP);
-    mp_obj_t n_value = n_attr->value;
-    uint8_t n_hal = (uint8_t)mp_obj_get_int(n_value);
-    mp_map_elem_t *bpp_attr = mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(MP_QSTR_bpp), MP_MAP_LOOKUP);
-    mp_obj_t bpp_value = bpp_attr->value;
-    uint8_t bpp_hal = (uint8_t)mp_obj_get_int(bpp_value);
-    int length = n_hal * bpp_hal;
+    // Build the table locally so a bad argument leaves the strip unchanged.
+    uint8_t table[256];
     mp_buffer_info_t bufinfo;
-    mp_get_buffer_raise(buf_value, &bufinfo, MP_BUFFER_READ);
-    neopixel_hal_write(id,length,bufinfo.buf);
+    if (mp_get_buffer(gamma_in, &bufinfo, MP_BUFFER_READ)) {
+        if (bufinfo.len != 256) {
+            mp_raise_ValueError(MP_ERROR_TEXT("gamma table must have 256 entries"));
+        }
+        memcpy(table, bufinfo.buf, 256);
+    } else if (mp_obj_is_type(gamma_in, &mp_type_list) || mp_obj_is_type(gamma_in, &mp_type_tuple)) {
+        size_t len;
+        mp_obj_t *items;
+        mp_obj_get_array(gamma_in, &len, &items);
+        if (len != 256) {
+            mp_raise_ValueError(MP_ERROR_TEXT("gamma table must have 256 entries"));
+        }
+        for (size_t i = 0; i < 256; ++i) {
+            mp_int_t value = mp_obj_get_int(items[i]);
+            if (value < 0 || value > 255) {
+                mp_raise_ValueError(MP_ERROR_TEXT("invalid gamma"));
+            }
+            table[i] = value;
+        }
+    } else {
+        mp_float_t exponent = mp_obj_get_float(gamma_in);
+        if (exponent <= 0) {
+            mp_raise_ValueError(MP_ERROR_TEXT("invalid gamma"));
+        }
+        for (size_t i = 0; i < 256; ++i) {
+            mp_float_t value = MICROPY_FLOAT_C_FUN(pow)((mp_float_t)i / 255, exponent);
+            table[i] = (uint8_t)(value * 255 + MICROPY_FLOAT_CONST(0.5));
+        }
+    }
+
+    if (self->gamma == NULL) {
+        self->gamma = m_new(uint8_t, 256);
+    }
+    memcpy(self->gamma, table, 256);
+    neopixel_update_lut(self);
     return mp_const_none;
 }
-MP_DEFINE_CONST_FUN_OBJ_1(mod_neopixel_write_obj, mod_neopixel_write_func);
+MP_DEFINE_CONST_FUN_OBJ_2(mod_neopixel_gamma_obj, mod_neopixel_gamma_func);
 
-STATIC mp_obj_t mod_neopixel_clear_func(mp_obj_t self_in) {
-    mp_obj_instance_t *self = MP_OBJ_TO_PTR(self_in);
+STATIC mp_obj_t mod_neopixel_animate_func(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_effect, ARG_speed, ARG_colors, ARG_size };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_effect, MP_ARG_REQUIRED | MP_ARG_OBJ },
+        { MP_QSTR_speed, MP_ARG_INT, {.u_int = 50} },
+        { MP_QSTR_colors, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_NONE} },
+        { MP_QSTR_size, MP_ARG_INT, {.u_int = 4} },
+    };
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(pos_args[0]);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
-    mp_map_elem_t *n_attr = mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(MP_QSTR_n), MP_MAP_LOOKUP);
-    size_t n_value = (size_t)mp_obj_get_int(n_attr->value);
+    neopixel_anim_stop(self);
+    if (args[ARG_effect].u_obj == mp_const_none) {
+        return mp_const_none;
+    }
 
-    mp_map_elem_t *bpp_attr = mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(MP_QSTR_bpp), MP_MAP_LOOKUP);
-    size_t bpp_value = (size_t)mp_obj_get_int(bpp_attr->value);
+    mp_int_t effect = mp_obj_get_int(args[ARG_effect].u_obj);
+    if (effect < NEOPIXEL_EFFECT_RAINBOW || effect > NEOPIXEL_EFFECT_FADE) {
+        mp_raise_ValueError(MP_ERROR_TEXT("invalid effect"));
+    }
+    if (args[ARG_speed].u_int <= 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("invalid speed"));
+    }
+    if (args[ARG_size].u_int <= 0 || args[ARG_size].u_int > 0xffff) {
+        mp_raise_ValueError(MP_ERROR_TEXT("invalid size"));
+    }
 
-	mp_map_elem_t *buf_attr = mp_map_lookup(&self->members, MP_OBJ_NEW_QSTR(MP_QSTR_buf), MP_MAP_LOOKUP);
-    mp_obj_array_t *pixel_array = MP_OBJ_TO_PTR(buf_attr->value);
+    neopixel_anim_t *anim = m_new_obj(neopixel_anim_t);
+    memset(anim->colors, 0, sizeof(anim->colors));
+    if (args[ARG_colors].u_obj == mp_const_none) {
+        memset(anim->colors[0], 255, self->bpp);
+        anim->num_colors = 1;
+    } else {
+        size_t len;
+        mp_obj_t *items;
+        mp_obj_get_array(args[ARG_colors].u_obj, &len, &items);
+        if (len == 0 || len > NEOPIXEL_ANIM_MAX_COLORS) {
+            mp_raise_ValueError(MP_ERROR_TEXT("invalid colors"));
+        }
+        for (size_t i = 0; i < len; ++i) {
+            neopixel_parse_color(self, items[i], anim->colors[i]);
+        }
+        anim->num_colors = len;
+    }
+    anim->strip = self;
+    anim->effect = effect;
+    anim->size = args[ARG_size].u_int;
+    anim->step = 0;
+    anim->rand_state = rng_generate_random_word() | 1;
+
+    // Frames are pushed from the timer callback, which can't allocate.
+    if (self->tx_buf == NULL) {
+        self->tx_buf = m_new(uint8_t, neopixel_buf_len(self));
+    }
 
-    size_t len = n_value * bpp_value;
-    mp_int_t color = 0;
+    anim->timer.pairheap.base.type = NULL;
+    anim->timer.flags = MICROBIT_SOFT_TIMER_FLAG_GC_ALLOCATED;
+    anim->timer.mode = MICROBIT_SOFT_TIMER_MODE_PERIODIC;
+    anim->timer.delta_ms = args[ARG_speed].u_int;
+    anim->timer.c_callback = neopixel_anim_callback;
+    self->anim = anim;
+    microbit_soft_timer_insert(&anim->timer, 0);
 
-    for (size_t i = 0; i < len; ++i) {
-        ((uint8_t *)pixel_array->items)[i] = color;
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(mod_neopixel_animate_obj, 2, mod_neopixel_animate_func);
+
+// Move the strip towards another frame: pixel += (other - pixel) * t.  The other
+// frame is a NeoPixel strip or a buffer in the same (wire) order as buf.
+STATIC mp_obj_t mod_neopixel_blend_func(mp_obj_t self_in, mp_obj_t other_in, mp_obj_t t_in) {
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    const uint8_t *other;
+    size_t len;
+    if (mp_obj_cast_to_native_base(other_in, MP_OBJ_FROM_PTR(&mod_NeoPixel_type)) != MP_OBJ_NULL) {
+        neopixel_obj_t *other_strip = neopixel_get_strip(other_in);
+        if (other_strip->format != self->format) {
+            mp_raise_ValueError(MP_ERROR_TEXT("order mismatch"));
+        }
+        other = neopixel_pixels(other_strip);
+        len = neopixel_buf_len(other_strip);
+    } else {
+        mp_buffer_info_t bufinfo;
+        mp_get_buffer_raise(other_in, &bufinfo, MP_BUFFER_READ);
+        other = bufinfo.buf;
+        len = bufinfo.len;
+    }
+    if (len != neopixel_buf_len(self)) {
+        mp_raise_ValueError(MP_ERROR_TEXT("length mismatch"));
     }
 
-    mod_neopixel_write_func(self_in);
+    mp_float_t t = mp_obj_get_float(t_in);
+    int32_t weight = t <= 0 ? 0 : t >= 1 ? 256 : (int32_t)(t * 256);
+    uint8_t *pixels = neopixel_pixels(self);
+    for (size_t i = 0; i < len; ++i) {
+        pixels[i] += ((int32_t)other[i] - pixels[i]) * weight >> 8;
+    }
+    neopixel_mark_dirty(self, 0, self->num_pixels);
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_3(mod_neopixel_blend_obj, mod_neopixel_blend_func);
 
+STATIC mp_obj_t mod_neopixel_clear_func(mp_obj_t self_in) {
+    neopixel_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    memset(neopixel_pixels(self), 0, neopixel_buf_len(self));
+    neopixel_mark_dirty(self, 0, self->num_pixels);
+    neopixel_write(self, true);
     return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_1(mod_neopixel_clear_obj, mod_neopixel_clear_func);
 
 STATIC const mp_rom_map_elem_t neopixel_module_locals_dict_table[] = {
-    { MP_ROM_QSTR(MP_QSTR___getitem__), MP_ROM_PTR(&mod_neopixel___get_item___obj) },
-    { MP_ROM_QSTR(MP_QSTR___init__), MP_ROM_PTR(&mod_neopixel___init___obj) },
-    { MP_ROM_QSTR(MP_QSTR___len__), MP_ROM_PTR(&mod_neopixel___len___obj) },
-    { MP_ROM_QSTR(MP_QSTR___module__), MP_OBJ_NEW_QSTR(MP_QSTR_neopixel) },
-    { MP_ROM_QSTR(MP_QSTR___qualname__), MP_OBJ_NEW_QSTR(MP_QSTR_NeoPixel) },
-    { MP_ROM_QSTR(MP_QSTR___setitem__), MP_ROM_PTR(&mod_neopixel___set_item___obj) },
     { MP_ROM_QSTR(MP_QSTR_clear), MP_ROM_PTR(&mod_neopixel_clear_obj) },
     { MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&mod_neopixel_write_obj) },
     { MP_ROM_QSTR(MP_QSTR_fill), MP_ROM_PTR(&mod_neopixel_fill_obj) },
-    { MP_ROM_QSTR(MP_QSTR_show), MP_ROM_PTR(&mod_neopixel_write_obj) },
+    { MP_ROM_QSTR(MP_QSTR_set_buffer), MP_ROM_PTR(&mod_neopixel_set_buffer_obj) },
+    { MP_ROM_QSTR(MP_QSTR_show), MP_ROM_PTR(&mod_neopixel_show_obj) },
+    { MP_ROM_QSTR(MP_QSTR_busy), MP_ROM_PTR(&mod_neopixel_busy_obj) },
+    { MP_ROM_QSTR(MP_QSTR_brightness), MP_ROM_PTR(&mod_neopixel_brightness_obj) },
+    { MP_ROM_QSTR(MP_QSTR_gamma), MP_ROM_PTR(&mod_neopixel_gamma_obj) },
+    { MP_ROM_QSTR(MP_QSTR_animate), MP_ROM_PTR(&mod_neopixel_animate_obj) },
+    { MP_ROM_QSTR(MP_QSTR_xy), MP_ROM_PTR(&mod_neopixel_xy_obj) },
+    { MP_ROM_QSTR(MP_QSTR_blit), MP_ROM_PTR(&mod_neopixel_blit_obj) },
+    { MP_ROM_QSTR(MP_QSTR_blend), MP_ROM_PTR(&mod_neopixel_blend_obj) },
     { MP_ROM_QSTR(MP_QSTR_ORDER),MP_ROM_PTR(&mod_neopixel_ORDER_obj) },
+    { MP_ROM_QSTR(MP_QSTR_RAINBOW), MP_ROM_INT(NEOPIXEL_EFFECT_RAINBOW) },
+    { MP_ROM_QSTR(MP_QSTR_CHASE), MP_ROM_INT(NEOPIXEL_EFFECT_CHASE) },
+    { MP_ROM_QSTR(MP_QSTR_COMET), MP_ROM_INT(NEOPIXEL_EFFECT_COMET) },
+    { MP_ROM_QSTR(MP_QSTR_TWINKLE), MP_ROM_INT(NEOPIXEL_EFFECT_TWINKLE) },
+    { MP_ROM_QSTR(MP_QSTR_FADE), MP_ROM_INT(NEOPIXEL_EFFECT_FADE) },
+    { MP_ROM_QSTR(MP_QSTR_TOP_LEFT), MP_ROM_INT(NEOPIXEL_ORIGIN_TOP_LEFT) },
+    { MP_ROM_QSTR(MP_QSTR_TOP_RIGHT), MP_ROM_INT(NEOPIXEL_ORIGIN_TOP_RIGHT) },
+    { MP_ROM_QSTR(MP_QSTR_BOTTOM_LEFT), MP_ROM_INT(NEOPIXEL_ORIGIN_BOTTOM_LEFT) },
+    { MP_ROM_QSTR(MP_QSTR_BOTTOM_RIGHT), MP_ROM_INT(NEOPIXEL_ORIGIN_BOTTOM_RIGHT) },
 };
 
 STATIC MP_DEFINE_CONST_DICT(neopixel_module_locals_dict, neopixel_module_locals_dict_table);
 
 const mp_obj_type_t mod_NeoPixel_type = {
     { &mp_type_type },
-    .attr = mp_obj_NeoPixel_attr,
-    .locals_dict = (mp_obj_dict_t*)&neopixel_module_locals_dict,
-    .make_new = mp_obj_NeoPixel_make_new,
     .name = MP_QSTR_NeoPixel,
-    .print = NeoPixel_print,
-    .subscr = NeoPixel_subscr,
-    .unary_op = NeoPixel_unary_op,
-
+    .print = mod_neopixel_print,
+    .make_new = mod_neopixel_make_new,
+    .unary_op = mod_neopixel_unary_op,
+    .subscr = mod_neopixel_subscr,
+    .attr = mod_neopixel_attr,
+    .locals_dict = (mp_obj_dict_t *)&neopixel_module_locals_dict,
 };
 
 //Module globals
 
 STATIC const mp_rom_map_elem_t neopixel_module_globals_table[] = {
-	{ MP_ROM_QSTR(MP_QSTR___name__), MP_OBJ_NEW_QSTR(MP_QSTR_neopixel) },
-	{ MP_ROM_QSTR(MP_QSTR_ws2812_write), MP_ROM_PTR(&microbit_ws2812_write_obj) },
-	{ MP_ROM_QSTR(MP_QSTR_NeoPixel), (mp_obj_t)&mod_NeoPixel_type },
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_OBJ_NEW_QSTR(MP_QSTR_neopixel) },
+    { MP_ROM_QSTR(MP_QSTR_ws2812_write), MP_ROM_PTR(&microbit_ws2812_write_obj) },
+    { MP_ROM_QSTR(MP_QSTR_write_all), MP_ROM_PTR(&mod_neopixel_write_all_obj) },
+    { MP_ROM_QSTR(MP_QSTR_hsv_fill), MP_ROM_PTR(&mod_neopixel_hsv_fill_obj) },
+    { MP_ROM_QSTR(MP_QSTR_NeoPixel), (mp_obj_t)&mod_NeoPixel_type },
 };
 
 STATIC MP_DEFINE_CONST_DICT(neopixel_module_globals, neopixel_module_globals_table);
 
 const mp_obj_module_t neopixel_module = {
     .base = { &mp_type_module },
-    .globals = (mp_obj_dict_t*)&neopixel_module_globals,
+    .globals = (mp_obj_dict_t *)&neopixel_module_globals,
 };
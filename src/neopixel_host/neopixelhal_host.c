@@ -0,0 +1,164 @@
+//Nico Kaiser
+// Host implementation of neopixelhal.h for running the NeoPixel module on a
+// Linux machine.  Every write is appended to a binary frame log which can be
+// inspected and replayed with neopixellog.py, and a summary of the frame rate
+// and throughput of each strip is printed to stderr at exit.
+//
+// The log file name is taken from the NEOPIXEL_LOG environment variable and
+// defaults to "neopixel.log".
+//
+// Log format (all integers little endian):
+//
+//   header:  "NPXL" magic, u16 version, u16 reserved
+//   record:  u8 type, 3 bytes reserved, u32 strip id, u64 timestamp in us,
+//            u32 offset, u32 length, followed by length bytes of data
+//
+// A CONFIG record (type 1) is written when a strip is created; its data is
+// u32 pin, u32 number of pixels, u32 bytes per pixel.  A FRAME record (type 2)
+// holds length bytes of pixel data in wire order, starting at byte offset of
+// the strip.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "neopixelhal.h"
+
+#define NEOPIXEL_LOG_VERSION (1)
+#define NEOPIXEL_LOG_CONFIG (1)
+#define NEOPIXEL_LOG_FRAME (2)
+#define NEOPIXEL_LOG_MAX_STRIPS (16)
+
+typedef struct _neopixel_log_strip_t {
+    int id;
+    size_t num_bytes;
+    unsigned long frames;
+    unsigned long long bytes;
+    uint64_t first_us;
+    uint64_t last_us;
+} neopixel_log_strip_t;
+
+static FILE *log_file;
+static size_t log_num_strips;
+static neopixel_log_strip_t log_strips[NEOPIXEL_LOG_MAX_STRIPS];
+
+static uint64_t neopixel_log_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void neopixel_log_put(uint64_t value, size_t n) {
+    uint8_t buf[8];
+    for (size_t i = 0; i < n; ++i) {
+        buf[i] = value >> (8 * i);
+    }
+    fwrite(buf, 1, n, log_file);
+}
+
+static void neopixel_log_stats(void) {
+    for (size_t i = 0; i < log_num_strips; ++i) {
+        neopixel_log_strip_t *strip = &log_strips[i];
+        double secs = (strip->last_us - strip->first_us) / 1e6;
+        fprintf(stderr, "neopixel %d: %zu bytes, %lu frames, %llu bytes sent",
+            strip->id, strip->num_bytes, strip->frames, strip->bytes);
+        if (strip->frames > 1 && secs > 0) {
+            fprintf(stderr, ", %.1f fps, %.0f bytes/s",
+                (strip->frames - 1) / secs, strip->bytes / secs);
+        }
+        fprintf(stderr, "\n");
+    }
+    if (log_file != NULL) {
+        fclose(log_file);
+        log_file = NULL;
+    }
+}
+
+static void neopixel_log_open(void) {
+    if (log_file != NULL) {
+        return;
+    }
+    const char *name = getenv("NEOPIXEL_LOG");
+    if (name == NULL) {
+        name = "neopixel.log";
+    }
+    log_file = fopen(name, "wb");
+    if (log_file == NULL) {
+        perror(name);
+        exit(1);
+    }
+    fwrite("NPXL", 1, 4, log_file);
+    neopixel_log_put(NEOPIXEL_LOG_VERSION, 2);
+    neopixel_log_put(0, 2);
+    atexit(neopixel_log_stats);
+}
+
+static void neopixel_log_record(int type, int id, size_t offset, size_t length, const uint8_t *data) {
+    neopixel_log_put(type, 1);
+    neopixel_log_put(0, 3);
+    neopixel_log_put((uint32_t)id, 4);
+    neopixel_log_put(neopixel_log_time_us(), 8);
+    neopixel_log_put(offset, 4);
+    neopixel_log_put(length, 4);
+    fwrite(data, 1, length, log_file);
+}
+
+static neopixel_log_strip_t *neopixel_log_find(int id) {
+    for (size_t i = 0; i < log_num_strips; ++i) {
+        if (log_strips[i].id == id) {
+            return &log_strips[i];
+        }
+    }
+    return NULL;
+}
+
+static void neopixel_log_frame(int id, size_t offset, size_t length, const uint8_t *buf) {
+    neopixel_log_strip_t *strip = neopixel_log_find(id);
+    if (strip == NULL) {
+        // Not created through neopixel_hal_NeoPixel, eg a raw ws2812_write.
+        neopixel_hal_NeoPixel(id, -1, offset + length, 1, NULL);
+        strip = neopixel_log_find(id);
+    }
+    uint64_t now = neopixel_log_time_us();
+    if (strip->frames == 0) {
+        strip->first_us = now;
+    }
+    strip->last_us = now;
+    strip->frames += 1;
+    strip->bytes += length;
+    neopixel_log_record(NEOPIXEL_LOG_FRAME, id, offset, length, buf);
+}
+
+void neopixel_hal_NeoPixel(int id, int pin, size_t len, size_t bytes_per_pixel, const uint8_t *buf) {
+    (void)buf;
+    neopixel_log_open();
+    neopixel_log_strip_t *strip = neopixel_log_find(id);
+    if (strip == NULL) {
+        if (log_num_strips == NEOPIXEL_LOG_MAX_STRIPS) {
+            // Reuse the oldest slot; its statistics are lost.
+            memmove(&log_strips[0], &log_strips[1], sizeof(log_strips) - sizeof(log_strips[0]));
+            --log_num_strips;
+        }
+        strip = &log_strips[log_num_strips++];
+    }
+    memset(strip, 0, sizeof(*strip));
+    strip->id = id;
+    strip->num_bytes = len * bytes_per_pixel;
+
+    uint8_t config[12];
+    uint32_t values[3] = { (uint32_t)pin, (uint32_t)len, (uint32_t)bytes_per_pixel };
+    for (size_t i = 0; i < 12; ++i) {
+        config[i] = values[i / 4] >> (8 * (i % 4));
+    }
+    neopixel_log_record(NEOPIXEL_LOG_CONFIG, id, 0, sizeof(config), config);
+}
+
+void neopixel_hal_write(int id, size_t length, const uint8_t *buf) {
+    neopixel_log_frame(id, 0, length, buf);
+}
+
+void neopixel_hal_write_range(int id, size_t offset, size_t length, const uint8_t *buf) {
+    neopixel_log_frame(id, offset, length, buf);
+}
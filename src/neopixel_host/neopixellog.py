@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+
+"""
+Inspect and replay a NeoPixel frame log written by neopixelhal_host.c.
+
+Usage: ./neopixellog.py stats <neopixel.log>
+       ./neopixellog.py dump <neopixel.log> [--strip ID]
+       ./neopixellog.py replay <neopixel.log> [--strip ID] [--speed X] [--order GRB]
+
+stats   prints per-strip frame counts, frame rate, throughput and the largest
+        gap between frames.
+dump    prints every record with its timestamp and the pixel values.
+replay  redraws each strip on an ANSI true-colour terminal with the original
+        timing, scaled by --speed.
+
+Pixel data in the log is in wire order; --order gives the channel order of the
+strip (GRB by default, with a trailing W for 4 bytes per pixel strips).
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+MAGIC = b"NPXL"
+VERSION = 1
+
+RECORD_CONFIG = 1
+RECORD_FRAME = 2
+
+RECORD_HEADER = struct.Struct("<B3xIQII")
+CONFIG_DATA = struct.Struct("<iII")
+
+
+class Strip:
+    def __init__(self, strip_id, pin, num_pixels, bpp):
+        self.id = strip_id
+        self.pin = pin
+        self.num_pixels = num_pixels
+        self.bpp = bpp
+        self.pixels = bytearray(num_pixels * bpp)
+        self.frames = 0
+        self.bytes = 0
+        self.first_us = None
+        self.last_us = None
+        self.max_gap_us = 0
+
+    def update(self, timestamp, offset, data):
+        end = offset + len(data)
+        if end > len(self.pixels):
+            self.pixels.extend(bytes(end - len(self.pixels)))
+        self.pixels[offset:end] = data
+        if self.first_us is None:
+            self.first_us = timestamp
+        else:
+            self.max_gap_us = max(self.max_gap_us, timestamp - self.last_us)
+        self.last_us = timestamp
+        self.frames += 1
+        self.bytes += len(data)
+
+
+def read_log(filename):
+    """Yield (type, strip id, timestamp, offset, data) for each record of the log."""
+    with open(filename, "rb") as f:
+        header = f.read(8)
+        if len(header) != 8 or header[:4] != MAGIC:
+            raise ValueError("{}: not a NeoPixel log".format(filename))
+        version = struct.unpack_from("<H", header, 4)[0]
+        if version != VERSION:
+            raise ValueError("{}: unsupported log version {}".format(filename, version))
+        while True:
+            record = f.read(RECORD_HEADER.size)
+            if len(record) < RECORD_HEADER.size:
+                # A truncated record at the end means the writer was killed.
+                break
+            rtype, strip_id, timestamp, offset, length = RECORD_HEADER.unpack(record)
+            data = f.read(length)
+            if len(data) < length:
+                break
+            yield rtype, strip_id, timestamp, offset, data
+
+
+def iter_strips(filename, strip_filter=None):
+    """Yield (strip, timestamp, record type) after applying each record."""
+    strips = {}
+    for rtype, strip_id, timestamp, offset, data in read_log(filename):
+        if strip_filter is not None and strip_id != strip_filter:
+            continue
+        if rtype == RECORD_CONFIG:
+            pin, num_pixels, bpp = CONFIG_DATA.unpack(data)
+            strips[strip_id] = Strip(strip_id, pin, num_pixels, bpp)
+        elif rtype == RECORD_FRAME:
+            if strip_id not in strips:
+                strips[strip_id] = Strip(strip_id, -1, 0, 1)
+            strips[strip_id].update(timestamp, offset, data)
+        else:
+            continue
+        yield strips[strip_id], timestamp, rtype
+
+
+def pixel_rgb(strip, index, order):
+    pixel = strip.pixels[index * strip.bpp : (index + 1) * strip.bpp]
+    if strip.bpp < 3:
+        return (pixel[0],) * 3
+    rgbw = {c: pixel[i] for i, c in enumerate(order[: strip.bpp])}
+    w = rgbw.get("W", 0)
+    return tuple(min(255, rgbw.get(c, 0) + w) for c in "RGB")
+
+
+def cmd_stats(args):
+    strips = {}
+    for strip, _, _ in iter_strips(args.log, args.strip):
+        strips[strip.id] = strip
+    for strip in strips.values():
+        print(
+            "strip {:#x}: pin {}, {} pixels x {} bytes".format(
+                strip.id, strip.pin, strip.num_pixels, strip.bpp
+            )
+        )
+        print("  {} frames, {} bytes sent".format(strip.frames, strip.bytes))
+        if strip.frames > 1 and strip.last_us > strip.first_us:
+            secs = (strip.last_us - strip.first_us) / 1e6
+            print(
+                "  {:.1f} fps, {:.0f} bytes/s, longest gap {:.1f} ms".format(
+                    (strip.frames - 1) / secs, strip.bytes / secs, strip.max_gap_us / 1e3
+                )
+            )
+
+
+def cmd_dump(args):
+    start = None
+    for rtype, strip_id, timestamp, offset, data in read_log(args.log):
+        if args.strip is not None and strip_id != args.strip:
+            continue
+        if start is None:
+            start = timestamp
+        t = (timestamp - start) / 1e3
+        if rtype == RECORD_CONFIG:
+            pin, num_pixels, bpp = CONFIG_DATA.unpack(data)
+            print(
+                "{:10.3f} ms  strip {:#x} config pin={} n={} bpp={}".format(
+                    t, strip_id, pin, num_pixels, bpp
+                )
+            )
+        elif rtype == RECORD_FRAME:
+            print(
+                "{:10.3f} ms  strip {:#x} write [{}:{}] {}".format(
+                    t, strip_id, offset, offset + len(data), data.hex()
+                )
+            )
+
+
+def cmd_replay(args):
+    order = args.order.upper()
+    start_log = None
+    start_wall = time.monotonic()
+    rows = {}
+    out = sys.stdout
+    out.write("\x1b[2J")
+    for strip, timestamp, rtype in iter_strips(args.log, args.strip):
+        if rtype != RECORD_FRAME:
+            continue
+        if start_log is None:
+            start_log = timestamp
+        delay = (timestamp - start_log) / 1e6 / args.speed - (time.monotonic() - start_wall)
+        if delay > 0:
+            time.sleep(delay)
+        if strip.id not in rows:
+            rows[strip.id] = len(rows) + 1
+        line = ["\x1b[{};1H".format(rows[strip.id])]
+        for i in range(len(strip.pixels) // strip.bpp):
+            line.append("\x1b[38;2;{};{};{}m█".format(*pixel_rgb(strip, i, order)))
+        line.append("\x1b[0m")
+        out.write("".join(line))
+        out.flush()
+    out.write("\x1b[{};1H\n".format(len(rows) + 1))
+
+
+def main():
+    cmd_parser = argparse.ArgumentParser(description="Inspect a NeoPixel frame log.")
+    cmd_parser.add_argument("command", choices=("stats", "dump", "replay"))
+    cmd_parser.add_argument("log", help="log file written by neopixelhal_host.c")
+    cmd_parser.add_argument(
+        "--strip", type=lambda x: int(x, 0), default=None, help="only show this strip id"
+    )
+    cmd_parser.add_argument("--speed", type=float, default=1.0, help="replay speed factor")
+    cmd_parser.add_argument("--order", default="GRBW", help="wire channel order")
+    args = cmd_parser.parse_args()
+
+    try:
+        {"stats": cmd_stats, "dump": cmd_dump, "replay": cmd_replay}[args.command](args)
+    except ValueError as er:
+        print("ERROR:", er)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()